@@ -1,4 +1,3 @@
-#include <WiFi.h>
 #include <time.h>
 
 #include <chrono>
@@ -10,12 +9,12 @@
 #include "ehal.h"
 #include "ehal_config.h"
 #include "ehal_diagnostics.h"
+#include "ehal_hal.h"
 #include "ehal_hp.h"
 #include "ehal_http.h"
 #include "ehal_mqtt.h"
 #include "ehal_thirdparty.h"
 
-bool mqttInitialized = false;
 bool heatpumpInitialized = false;
 uint8_t ledTick = 0;
 const uint8_t ledTickPatternHpDisconnect[] = { HIGH, LOW, HIGH, LOW, HIGH, HIGH, HIGH, HIGH, LOW };
@@ -240,7 +239,7 @@ void setup()
     {
         ehal::http::initialize_default();
         heatpumpInitialized = ehal::hp::initialize();
-        mqttInitialized = ehal::mqtt::initialize();
+        ehal::mqtt::initialize();
     }
 
     pinMode(ehal::config_instance().StatusLed, OUTPUT);
@@ -248,24 +247,21 @@ void setup()
     log_last_reset_reason();
     ehal::log_web(F("Ecodan HomeAssistant Bridge startup successful, starting request processing."));
 
-    ehal::init_watchdog();
-    ehal::add_thread_to_watchdog();
+    ehal::hal::init_watchdog();
+    ehal::hal::add_thread_to_watchdog();
 }
 
 void loop()
 {
     try
     {
-        ehal::ping_watchdog();
+        ehal::hal::ping_watchdog();
 
         ehal::http::handle_loop();
 
         if (heatpumpInitialized)
             ehal::hp::handle_loop();
 
-        if (mqttInitialized)
-            ehal::mqtt::handle_loop();
-
         update_time(/* force =*/false);
         update_status_led();
 
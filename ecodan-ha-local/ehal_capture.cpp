@@ -0,0 +1,145 @@
+#include "ehal_capture.h"
+#include "ehal_diagnostics.h"
+#include "ehal_hal.h"
+#include "ehal_proto.h"
+#include "psram_alloc.h"
+
+#include <sys/time.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+
+#define CAPTURE_PSRAM_FRAMES 4096 // 128KiB, ~35 minutes of polling.
+#define CAPTURE_HEAP_FRAMES 256 // 8KiB, for boards without PSRAM.
+#define CAPTURE_WRITE_BATCH 32
+
+namespace ehal::capture
+{
+    struct FrameRecord
+    {
+        uint64_t TimestampUs;
+        Direction Dir;
+        uint8_t Length;
+        uint8_t Frame[hp::TOTAL_MSG_SIZE];
+    };
+
+    std::mutex captureLock;
+    FrameRecord* ring = nullptr;
+    size_t ringCapacity = 0;
+    uint64_t writeSeq = 0; // Total frames ever recorded, ring[writeSeq % ringCapacity] is written next.
+    bool allocationFailed = false; // Capture stays disabled, rather than retrying for every frame.
+
+    bool allocate_ring()
+    {
+        if (allocationFailed)
+            return false;
+
+        size_t capacity = psram::exists() ? CAPTURE_PSRAM_FRAMES : CAPTURE_HEAP_FRAMES;
+        try
+        {
+            ring = psram::allocator<FrameRecord>().allocate(capacity);
+        }
+        catch (const std::bad_alloc&)
+        {
+            allocationFailed = true;
+            log_web(F("Unable to allocate packet capture for %u frames, capture disabled"), static_cast<unsigned>(capacity));
+            return false;
+        }
+
+        ringCapacity = capacity;
+        return true;
+    }
+
+    void record(Direction direction, const uint8_t* frame, size_t length)
+    {
+        uint64_t now = hal::uptime_us();
+
+        std::lock_guard<std::mutex> lock{captureLock};
+
+        if (ring == nullptr && !allocate_ring())
+            return;
+
+        FrameRecord& r = ring[writeSeq++ % ringCapacity];
+        r.TimestampUs = now;
+        r.Dir = direction;
+        r.Length = std::min<size_t>(length, sizeof(r.Frame));
+        memcpy(r.Frame, frame, r.Length);
+    }
+
+    size_t frame_count()
+    {
+        std::lock_guard<std::mutex> lock{captureLock};
+        return std::min<uint64_t>(writeSeq, ringCapacity);
+    }
+
+    size_t capacity()
+    {
+        std::lock_guard<std::mutex> lock{captureLock};
+        return ringCapacity;
+    }
+
+    uint64_t overwritten_frame_count()
+    {
+        std::lock_guard<std::mutex> lock{captureLock};
+        return writeSeq > ringCapacity ? writeSeq - ringCapacity : 0;
+    }
+
+    void write_pcap(const std::function<void(const uint8_t* data, size_t length)>& sink)
+    {
+        PcapFileHeader header = {};
+        header.Magic = PCAP_MAGIC;
+        header.VersionMajor = PCAP_VERSION_MAJOR;
+        header.VersionMinor = PCAP_VERSION_MINOR;
+        header.SnapLen = PCAP_SNAPLEN;
+        header.LinkType = PCAP_LINKTYPE_USER0;
+        sink(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+
+        // Frames are timestamped with uptime, convert to wall-clock time for the file.
+        struct timeval tv = {};
+        gettimeofday(&tv, nullptr);
+        uint64_t epochOffsetUs = (uint64_t(tv.tv_sec) * 1000000ULL + tv.tv_usec) - hal::uptime_us();
+
+        const size_t maxPacketSize = sizeof(PcapRecordHeader) + sizeof(Direction) + hp::TOTAL_MSG_SIZE;
+        auto buffer = std::unique_ptr<uint8_t[]>(new uint8_t[CAPTURE_WRITE_BATCH * maxPacketSize]);
+
+        uint64_t readSeq = 0;
+        while (true)
+        {
+            size_t offset = 0;
+
+            {
+                // Copy a batch at a time, so recording isn't blocked for the whole download.
+                std::lock_guard<std::mutex> lock{captureLock};
+
+                if (writeSeq > ringCapacity && readSeq < writeSeq - ringCapacity)
+                    readSeq = writeSeq - ringCapacity; // Overwritten while we were sending.
+
+                for (size_t i = 0; i < CAPTURE_WRITE_BATCH && readSeq < writeSeq; ++i, ++readSeq)
+                {
+                    const FrameRecord& r = ring[readSeq % ringCapacity];
+                    uint64_t timestampUs = r.TimestampUs + epochOffsetUs;
+
+                    PcapRecordHeader recordHeader = {};
+                    recordHeader.TimestampSec = timestampUs / 1000000ULL;
+                    recordHeader.TimestampUsec = timestampUs % 1000000ULL;
+                    recordHeader.CapturedLength = sizeof(Direction) + r.Length;
+                    recordHeader.OriginalLength = recordHeader.CapturedLength;
+
+                    memcpy(buffer.get() + offset, &recordHeader, sizeof(recordHeader));
+                    offset += sizeof(recordHeader);
+                    buffer[offset++] = static_cast<uint8_t>(r.Dir);
+                    memcpy(buffer.get() + offset, r.Frame, r.Length);
+                    offset += r.Length;
+                }
+            }
+
+            if (offset == 0)
+                break;
+
+            sink(buffer.get(), offset);
+        }
+    }
+} // namespace ehal::capture
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <cstdint>
+#include <functional>
+
+namespace ehal::capture
+{
+    // Captures download as a classic pcap file (https://www.tcpdump.org/manpages/pcap-savefile.5.txt)
+    // with microsecond timestamps and LINKTYPE_USER0. Each packet is a Direction byte followed by the
+    // raw CN105 frame, exactly as it was sent/received on the wire.
+    const uint32_t PCAP_MAGIC = 0xA1B2C3D4;
+    const uint16_t PCAP_VERSION_MAJOR = 2;
+    const uint16_t PCAP_VERSION_MINOR = 4;
+    const uint32_t PCAP_LINKTYPE_USER0 = 147;
+    const uint32_t PCAP_SNAPLEN = 64;
+
+    struct PcapFileHeader
+    {
+        uint32_t Magic;
+        uint16_t VersionMajor;
+        uint16_t VersionMinor;
+        int32_t ThisZone;
+        uint32_t SigFigs;
+        uint32_t SnapLen;
+        uint32_t LinkType;
+    };
+
+    struct PcapRecordHeader
+    {
+        uint32_t TimestampSec;
+        uint32_t TimestampUsec;
+        uint32_t CapturedLength;
+        uint32_t OriginalLength;
+    };
+
+    enum class Direction : uint8_t
+    {
+        TX = 0, // Sent to the heat pump
+        RX = 1  // Received from the heat pump
+    };
+
+    // Copies a frame into the capture ring, overwriting the oldest frame once it is full.
+    void record(Direction direction, const uint8_t* frame, size_t length);
+
+    size_t frame_count();
+    size_t capacity();
+    uint64_t overwritten_frame_count();
+
+    // Serializes the capture ring (oldest frame first) as a pcap file, in chunks.
+    void write_pcap(const std::function<void(const uint8_t* data, size_t length)>& sink);
+} // namespace ehal::capture
@@ -1,8 +1,7 @@
 #include "ehal_config.h"
+#include "ehal_hal.h"
 #include "ehal.h"
 
-#include <Preferences.h>
-
 #ifndef LED_BUILTIN
     #define LED_BUILTIN 15
 #endif
@@ -25,8 +24,11 @@ namespace ehal
         config.SerialRxPort = prefs.getUShort("serial_rx", 27U);
         config.SerialTxPort = prefs.getUShort("serial_tx", 26U);
         config.StatusLed = prefs.getUShort("status_led", LED_BUILTIN);
-        config.DumpPackets = prefs.getBool("dump_pkt", false);
+        config.CapturePackets = prefs.getBool("dump_pkt", false);
+        config.UartEventRx = prefs.getBool("uart_evt_rx", true);
         config.CoolEnabled = prefs.getBool("cool_enabled", false);
+        config.PollIntervals = prefs.getString("poll_intervals");
+        config.SetCoalesceMs = prefs.getUShort("set_coalesce", 500U);
         config.UniqueId = prefs.getString("unique_id", device_mac());
         config.WifiReset = prefs.getBool("wifi_reset", true);
         config.HostName = prefs.getString("hostname", "ecodan_ha_local");
@@ -38,6 +40,13 @@ namespace ehal
         config.MqttUserName = prefs.getString("mqtt_username");
         config.MqttPassword = prefs.getString("mqtt_pw");
         config.MqttTopic = prefs.getString("mqtt_topic", "ecodan_hp");
+        config.MqttTempDeadband = prefs.getFloat("mqtt_temp_db", 0.1f);
+        config.MqttRefreshInterval = prefs.getUShort("mqtt_refresh", 120U);
+        config.MqttAggregateState = prefs.getBool("mqtt_agg_state", false);
+        config.MqttStateQos = prefs.getUChar("mqtt_state_qos", 0);
+        config.MqttDiscoveryQos = prefs.getUChar("mqtt_disc_qos", 1);
+        config.MqttCommandQos = prefs.getUChar("mqtt_cmd_qos", 1);
+        config.MqttTaskCore = prefs.getUChar("mqtt_core", 0);
 
         prefs.end();
 
@@ -52,8 +61,11 @@ namespace ehal
         prefs.putUShort("serial_rx", config.SerialRxPort);
         prefs.putUShort("serial_tx", config.SerialTxPort);
         prefs.putUShort("status_led", config.StatusLed);
-        prefs.putBool("dump_pkt", config.DumpPackets);
+        prefs.putBool("dump_pkt", config.CapturePackets);
+        prefs.putBool("uart_evt_rx", config.UartEventRx);
         prefs.putBool("cool_enabled", config.CoolEnabled);
+        prefs.putString("poll_intervals", config.PollIntervals);
+        prefs.putUShort("set_coalesce", config.SetCoalesceMs);
         prefs.putString("unique_id", config.UniqueId);
         prefs.putBool("wifi_reset", config.WifiReset);
         prefs.putString("wifi_ssid", config.WifiSsid);
@@ -64,6 +76,13 @@ namespace ehal
         prefs.putString("mqtt_username", config.MqttUserName);
         prefs.putString("mqtt_pw", config.MqttPassword);
         prefs.putString("mqtt_topic", config.MqttTopic);
+        prefs.putFloat("mqtt_temp_db", config.MqttTempDeadband);
+        prefs.putUShort("mqtt_refresh", config.MqttRefreshInterval);
+        prefs.putBool("mqtt_agg_state", config.MqttAggregateState);
+        prefs.putUChar("mqtt_state_qos", config.MqttStateQos);
+        prefs.putUChar("mqtt_disc_qos", config.MqttDiscoveryQos);
+        prefs.putUChar("mqtt_cmd_qos", config.MqttCommandQos);
+        prefs.putUChar("mqtt_core", config.MqttTaskCore);
         prefs.end();
 
         return true;
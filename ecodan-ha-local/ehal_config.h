@@ -11,8 +11,11 @@ namespace ehal
         uint16_t SerialRxPort;
         uint16_t SerialTxPort;
         uint16_t StatusLed;
-        bool DumpPackets;
+        bool CapturePackets;
+        bool UartEventRx;
         bool CoolEnabled;
+        String PollIntervals;
+        uint16_t SetCoalesceMs;
         String UniqueId;
         bool WifiReset;
         String WifiSsid;
@@ -23,6 +26,13 @@ namespace ehal
         String MqttUserName;
         String MqttPassword;
         String MqttTopic;
+        float MqttTempDeadband;
+        uint16_t MqttRefreshInterval;
+        bool MqttAggregateState;
+        uint8_t MqttStateQos;
+        uint8_t MqttDiscoveryQos;
+        uint8_t MqttCommandQos;
+        uint8_t MqttTaskCore;
         String BootTime;
     };
 
@@ -0,0 +1,223 @@
+#include "ehal_diagnostics.h"
+#include "ehal_hal.h"
+
+#if ARDUINO_ARCH_ESP32
+#include <driver/uart.h>
+#include <esp_chip_info.h>
+#include <esp_pthread.h>
+#include <esp_task_wdt.h>
+#include <esp_timer.h>
+#include <freertos/task.h>
+#else
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <thread>
+#endif
+
+#define WATCHDOG_TIMEOUT_MS 30000U
+
+namespace ehal::hal
+{
+#if ARDUINO_ARCH_ESP32
+    TaskHandle current_task()
+    {
+        return xTaskGetCurrentTaskHandle();
+    }
+
+    bool wait_for_notification(uint32_t timeoutMs)
+    {
+        return ulTaskNotifyTakeIndexed(0, pdTRUE, pdMS_TO_TICKS(timeoutMs)) > 0;
+    }
+
+    void notify(TaskHandle task)
+    {
+        xTaskNotifyGiveIndexed(static_cast<TaskHandle_t>(task), 0);
+    }
+
+    void IRAM_ATTR notify_from_isr(TaskHandle task)
+    {
+        BaseType_t higherPriorityTaskWoken = pdFALSE;
+        vTaskNotifyGiveIndexedFromISR(static_cast<TaskHandle_t>(task), 0, &higherPriorityTaskWoken);
+#if CONFIG_IDF_TARGET_ESP32C3
+        portEND_SWITCHING_ISR(higherPriorityTaskWoken);
+#else
+        portYIELD_FROM_ISR(higherPriorityTaskWoken);
+#endif
+    }
+
+    std::thread start_thread(const char* name, uint8_t core, size_t stackSize, void (*fn)())
+    {
+        // std::thread is backed by pthreads, which take their FreeRTOS task settings from the creating thread.
+        esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+        cfg.thread_name = name;
+        cfg.stack_size = stackSize;
+        cfg.pin_to_core = core < portNUM_PROCESSORS ? core : tskNO_AFFINITY;
+        esp_pthread_set_cfg(&cfg);
+
+        std::thread thread{fn};
+
+        cfg = esp_pthread_get_default_config();
+        esp_pthread_set_cfg(&cfg);
+        return thread;
+    }
+
+    bool serial_tx_done(uint8_t uartNum, uint32_t timeoutMs)
+    {
+        return uart_wait_tx_done(static_cast<uart_port_t>(uartNum), pdMS_TO_TICKS(timeoutMs)) == ESP_OK;
+    }
+
+    uint64_t uptime_us()
+    {
+        return esp_timer_get_time();
+    }
+
+    void init_watchdog()
+    {
+        esp_chip_info_t info = {};
+        esp_chip_info(&info);
+
+        // Reset the board if the watchdog timer isn't reset every 30s.
+        esp_task_wdt_config_t config = {};
+        config.timeout_ms = WATCHDOG_TIMEOUT_MS;
+        config.idle_core_mask = ((1 << info.cores) - 1);
+        config.trigger_panic = true;
+
+        esp_err_t ret = esp_task_wdt_init(&config);
+        if (ret == ESP_ERR_INVALID_STATE)
+            ret = esp_task_wdt_reconfigure(&config);
+
+        if (ret == ESP_OK)
+            log_web(F("Watchdog initialized."));
+        else
+            log_web(F("Watchdog initialization failed!"));
+    }
+
+    void add_thread_to_watchdog()
+    {
+        esp_task_wdt_add(nullptr);
+    }
+
+    void ping_watchdog()
+    {
+        esp_task_wdt_reset();
+    }
+#else
+    struct NativeTask
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        uint32_t notifications = 0;
+    };
+
+    thread_local NativeTask currentTask;
+
+    std::mutex watchdogLock;
+    std::map<std::thread::id, std::chrono::steady_clock::time_point> watchdogThreads;
+
+    TaskHandle current_task()
+    {
+        return &currentTask;
+    }
+
+    bool wait_for_notification(uint32_t timeoutMs)
+    {
+        std::unique_lock<std::mutex> lock{currentTask.mutex};
+        currentTask.cv.wait_for(lock, std::chrono::milliseconds(timeoutMs), []()
+        {
+            return currentTask.notifications > 0;
+        });
+
+        bool notified = currentTask.notifications > 0;
+        currentTask.notifications = 0;
+        return notified;
+    }
+
+    void notify(TaskHandle task)
+    {
+        notify_from_isr(task);
+    }
+
+    void notify_from_isr(TaskHandle task)
+    {
+        auto* nativeTask = static_cast<NativeTask*>(task);
+        {
+            std::lock_guard<std::mutex> lock{nativeTask->mutex};
+            ++nativeTask->notifications;
+        }
+        nativeTask->cv.notify_one();
+    }
+
+    std::thread start_thread(const char* name, uint8_t core, size_t stackSize, void (*fn)())
+    {
+        return std::thread{fn};
+    }
+
+    bool serial_tx_done(uint8_t uartNum, uint32_t timeoutMs)
+    {
+        auto start = std::chrono::steady_clock::now();
+        while (!native_serial_tx_done(uartNum))
+        {
+            if (std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(timeoutMs))
+                return false;
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        return true;
+    }
+
+    uint64_t uptime_us()
+    {
+        static const auto boot = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - boot).count();
+    }
+
+    // Abort (rather than reset) when a thread stalls, so the hang shows up in a debugger / sanitizer report.
+    void init_watchdog()
+    {
+        static std::once_flag started;
+        std::call_once(started, []()
+        {
+            std::thread watchdog([]()
+            {
+                while (true)
+                {
+                    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+                    std::lock_guard<std::mutex> lock{watchdogLock};
+                    for (const auto& thread : watchdogThreads)
+                    {
+                        if (std::chrono::steady_clock::now() - thread.second > std::chrono::milliseconds(WATCHDOG_TIMEOUT_MS))
+                        {
+                            fprintf(stderr, "Task watchdog expired, a subscribed thread has not pinged in %ums\n", WATCHDOG_TIMEOUT_MS);
+                            abort();
+                        }
+                    }
+                }
+            });
+
+            watchdog.detach();
+        });
+
+        log_web(F("Watchdog initialized."));
+    }
+
+    void add_thread_to_watchdog()
+    {
+        std::lock_guard<std::mutex> lock{watchdogLock};
+        watchdogThreads[std::this_thread::get_id()] = std::chrono::steady_clock::now();
+    }
+
+    void ping_watchdog()
+    {
+        std::lock_guard<std::mutex> lock{watchdogLock};
+        auto it = watchdogThreads.find(std::this_thread::get_id());
+        if (it != std::end(watchdogThreads))
+            it->second = std::chrono::steady_clock::now();
+    }
+#endif
+} // namespace ehal::hal
@@ -0,0 +1,47 @@
+#pragma once
+
+/*
+ * Thin hardware abstraction over the Arduino/ESP-IDF facilities used by the core modules.
+ *
+ * On the ESP32 the peripheral classes (HardwareSerial, WiFiClient, WebServer, Preferences, ...) are the
+ * ones from the board package, and the functions below forward to FreeRTOS / esp_task_wdt. The "native"
+ * PlatformIO environment puts hal/native on the include path instead, which provides Linux implementations
+ * of the same classes, so the core can be built and run on a PC.
+ */
+
+#include <Arduino.h>
+#include <DNSServer.h>
+#include <HardwareSerial.h>
+#include <Preferences.h>
+#include <Update.h>
+#include <WebServer.h>
+#include <WiFi.h>
+#include <WiFiClient.h>
+
+#include <cstdint>
+#include <thread>
+
+namespace ehal::hal
+{
+    using TaskHandle = void*;
+
+    // Task notifications, used to wake a thread from an interrupt handler.
+    TaskHandle current_task();
+    bool wait_for_notification(uint32_t timeoutMs);
+    void notify(TaskHandle task);
+    void notify_from_isr(TaskHandle task);
+
+    // Starts a thread pinned to a core (ignored on single core boards and natively).
+    std::thread start_thread(const char* name, uint8_t core, size_t stackSize, void (*fn)());
+
+    // Returns true once everything written to the UART has left the wire, waiting up to timeoutMs.
+    bool serial_tx_done(uint8_t uartNum, uint32_t timeoutMs);
+
+    // Monotonic time since boot, which (unlike micros()) doesn't wrap after ~71 minutes.
+    uint64_t uptime_us();
+
+    // Task watchdog, resets the board if a subscribed thread stops pinging it.
+    void init_watchdog();
+    void add_thread_to_watchdog();
+    void ping_watchdog();
+} // namespace ehal::hal
@@ -1,31 +1,170 @@
 #include "ehal.h"
+#include "ehal_capture.h"
 #include "ehal_config.h"
 #include "ehal_diagnostics.h"
+#include "ehal_hal.h"
 #include "ehal_hp.h"
+#include "ehal_hp_registers.h"
+#include "ehal_hp_settings.h"
 #include "ehal_proto.h"
+#include "spsc_queue.h"
 
-#include <HardwareSerial.h>
-#include <freertos/task.h>
-
+#include <algorithm>
+#include <atomic>
+#include <map>
 #include <mutex>
 #include <queue>
 #include <thread>
 
 namespace ehal::hp
 {
+#define UART_RX_IDLE_SYMBOLS 2 // CN105 frames are sent back-to-back, so a 2 character gap marks the end of one.
+#define UART_NUM 1 // Serial1
+#define UART_TX_RING_SIZE 256 // Room for ~10 queued frames, must exceed the 128 byte hardware FIFO.
+#define UART_TX_FRAME_TIMEOUT_MS 200 // A full frame takes ~92ms on the wire at 2400 baud.
+#define CMD_RESPONSE_TIMEOUT_MS 500 // ~92ms each way on the wire, plus the controller's turn-around time.
+#define CMD_MAX_RETRANSMITS 3
+#define FRAME_TIME_MS 100 // A 22-byte frame at 2400 baud 8E1 is ~92ms on the wire.
+#define POLL_COST_MS (2 * FRAME_TIME_MS) // A GET_CMD and its GET_RES.
+#define POLL_BUS_UTILIZATION_PERCENT 60 // Headroom is left on the bus for retransmits and user settings.
+#define POLL_SLOT_MS (POLL_COST_MS * 100 / POLL_BUS_UTILIZATION_PERCENT) // Minimum spacing between GET_CMDs.
+#define POLL_INTERVAL_MIN_S 10 // Range of a "Poll Intervals" override, other than 0 (disabled).
+#define POLL_INTERVAL_MAX_S 600
+#define STATUS_DELTA_QUEUE_SIZE 32
+
     HardwareSerial port = Serial1;
     uint64_t rxMsgCount = 0;
     uint64_t txMsgCount = 0;
+    std::atomic<uint32_t> rxWakeCount{0};
+    uint64_t rxBusyMicros = 0;
+    uint64_t txBusyMicros = 0;
+    uint64_t txRingFullCount = 0;
 
-    TaskHandle_t serialRxTaskHandle = nullptr;
+    hal::TaskHandle serialRxTaskHandle = nullptr;
     std::thread serialRxThread;
-    std::queue<Message> cmdQueue;
+    FrameParser rxParser;
+
+    SpscQueue<StatusDelta, STATUS_DELTA_QUEUE_SIZE> statusDeltas; // Serial rx thread -> statusDeltaConsumer
+    std::atomic<hal::TaskHandle> statusDeltaConsumer{nullptr};
+    std::atomic<uint32_t> statusDeltaOverflowCount{0};
+    uint64_t pollCycleChangedFields = 0; // Serial rx thread only
+
+    // User settings (SET_CMD) always go out ahead of status polling (GET_CMD), and a poll refresh
+    // only ever replaces the GET queue. Both guarded by cmdQueueMutex.
+    std::queue<QueuedCommand> setCmdQueue;
+    std::queue<QueuedCommand> getCmdQueue;
     std::mutex cmdQueueMutex;
 
+    struct QueueWaitCounters
+    {
+        uint32_t Count = 0;
+        uint64_t TotalWaitMs = 0;
+        uint32_t MaxWaitMs = 0;
+        uint32_t MaxDepth = 0;
+    } setQueueCounters, getQueueCounters;
+
+    // Settings held for the coalescing window, see hold_pending_setting(). Guarded by cmdQueueMutex.
+    std::vector<PendingSetting> pendingSettings;
+
+    // Zone targets requested but not yet reported back by the heat pump, so that a change to one zone doesn't
+    // revert the other to its last reported target. Kept until a zone temperature read arrives with no zone
+    // temperature SET_CMD held, queued or awaiting a response. Guarded by cmdQueueMutex.
+    std::optional<float> requestedZone1Temperature;
+    std::optional<float> requestedZone2Temperature;
+    uint32_t queuedZoneTemperatureSets = 0; // Queued or in flight
+    uint32_t coalescedSetCount = 0;
+    uint32_t mergedSetCount = 0; // SET_CMDs saved by merging BASIC_SETTINGS frames.
+
+    // The controller answers one request at a time, so only a single command is outstanding on
+    // the link. Guarded by cmdQueueMutex.
+    struct InFlightCommand
+    {
+        Message Msg;
+        bool Active = false;
+        bool Readback = false;
+        uint8_t Retransmits = 0;
+        std::chrono::steady_clock::time_point SentAt;
+        std::chrono::steady_clock::time_point RequestedAt;
+    } inFlight;
+
+    // Setting requested -> read-back received, bucketed by ConfirmLatencyHistogram::UPPER_BOUND_MS.
+    // Guarded by cmdQueueMutex.
+    uint32_t confirmLatencyCounts[ConfirmLatencyHistogram::BUCKETS] = {};
+
+    struct CommandCounters
+    {
+        uint32_t Count = 0;
+        uint32_t Retransmits = 0;
+        uint32_t Failures = 0;
+        uint64_t TotalRttMs = 0;
+        uint32_t MaxRttMs = 0;
+    };
+
+    // Keyed by (MsgType << 8 | payload type), guarded by cmdQueueMutex.
+    std::map<uint16_t, CommandCounters> commandCounters;
+
+    // How often each register is polled (0 disables polling), overridable from the "Poll Intervals" setting.
+    // Guarded by cmdQueueMutex.
+    struct PollSchedule
+    {
+        GetType Type;
+        uint32_t IntervalMs;
+        std::chrono::steady_clock::time_point Due;
+    } pollSchedule[] = {
+        {GetType::DEFROST_STATE, 10000, {}},
+        {GetType::COMPRESSOR_FREQUENCY, 10000, {}},
+        {GetType::FORCED_DHW_STATE, 30000, {}},
+        {GetType::HEATING_POWER, 10000, {}},
+        {GetType::TEMPERATURE_CONFIG, 60000, {}},
+        {GetType::SH_TEMPERATURE_STATE, 30000, {}},
+        {GetType::DHW_TEMPERATURE_STATE_A, 30000, {}},
+        {GetType::DHW_TEMPERATURE_STATE_B, 30000, {}},
+        {GetType::ACTIVE_TIME, 0, {}},
+        {GetType::FLOW_RATE, 15000, {}},
+        {GetType::MODE_FLAGS_A, 15000, {}},
+        {GetType::MODE_FLAGS_B, 60000, {}},
+        {GetType::ENERGY_USAGE, 600000, {}},
+        {GetType::ENERGY_DELIVERY, 600000, {}}};
+
+    // Earliest time the next GET_CMD may be queued without exceeding POLL_BUS_UTILIZATION_PERCENT.
+    std::chrono::steady_clock::time_point nextPollSlot;
+    std::chrono::steady_clock::time_point linkStartTime;
+
+    // Seqlock around the decoded status. Writers are serialized by statusWriteMutex and hold statusSeq odd
+    // while they modify status; readers never block, they just retry their copy if statusSeq moved under them.
     Status status;
+    std::atomic<uint32_t> statusSeq{0};
+    std::mutex statusWriteMutex;
+
+    template <typename Fn>
+    void write_status(Fn&& fn)
+    {
+        std::lock_guard<std::mutex> lock{statusWriteMutex};
+
+        uint32_t seq = statusSeq.load(std::memory_order_relaxed);
+        statusSeq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        fn(status);
+
+        statusSeq.store(seq + 2, std::memory_order_release);
+    }
     float temperatureStep = 0.5f;
     bool connected = false;
 
+    // Blocks until the frames already handed to the UART driver have been transmitted.
+    bool wait_for_tx_complete(uint32_t timeoutMs)
+    {
+        return hal::serial_tx_done(UART_NUM, timeoutMs);
+    }
+
+    bool tx_ring_has_room(size_t length)
+    {
+        int available = port.availableForWrite();
+        return available >= 0 && static_cast<size_t>(available) >= length;
+    }
+
+    // Queues a frame in the UART driver's tx ring buffer and returns without waiting for it to be sent.
     bool serial_tx(Message& msg)
     {
         if (!port)
@@ -34,43 +173,58 @@ namespace ehal::hp
             return false;
         }
 
-        if (port.availableForWrite() < msg.size())
+        unsigned long startMicros = micros();
+
+        if (!tx_ring_has_room(msg.size()))
         {
-            log_web(F("Serial tx buffer size: %u"), port.availableForWrite());
-            return false;
+            ++txRingFullCount;
+            if (!wait_for_tx_complete(UART_TX_FRAME_TIMEOUT_MS) || !tx_ring_has_room(msg.size()))
+            {
+                log_web(F("Serial tx buffer size: %u"), port.availableForWrite());
+                return false;
+            }
         }
 
         msg.set_checksum();
         port.write(msg.buffer(), msg.size());
-	port.flush();
+
+        txBusyMicros += micros() - startMicros;
 
         auto& config = config_instance();
-        if (config.DumpPackets)
+        if (config.CapturePackets)
         {
-            msg.debug_dump_packet();
+            capture::record(capture::Direction::TX, msg.buffer(), msg.size());
         }
 
         ++txMsgCount;
         return true;
     }
 
-    void clear_command_queue()
+    bool is_zone_temperature_cmd(Message& cmd)
     {
-        std::lock_guard<std::mutex> lock{cmdQueueMutex};
+        return cmd.type() == MsgType::SET_CMD && cmd.payload_type<SetType>() == SetType::BASIC_SETTINGS && (cmd[1] & SET_SETTINGS_FLAG_ZONE_TEMPERATURE);
+    }
 
-        while (!cmdQueue.empty())
-            cmdQueue.pop();
+    // Requires cmdQueueMutex.
+    void retire_in_flight_cmd_locked()
+    {
+        if (inFlight.Active && is_zone_temperature_cmd(inFlight.Msg))
+            --queuedZoneTemperatureSets;
+
+        inFlight.Active = false;
     }
 
-    void resync_rx()
+    // Drops the in-flight command and any queued status polls once the link is lost. Queued settings are
+    // kept, and go out ahead of the next status poll after reconnecting. Requires cmdQueueMutex.
+    void clear_command_queue_locked()
     {
-        while (port.available() > 0)
-            port.read();
+        retire_in_flight_cmd_locked();
 
-        clear_command_queue();
+        while (!getCmdQueue.empty())
+            getCmdQueue.pop();
     }
 
-    bool serial_rx(Message& msg)
+    bool serial_rx(Message& msg, uint32_t timeoutMs)
     {
         if (!port)
         {
@@ -78,75 +232,36 @@ namespace ehal::hp
             return false;
         }
 
-        if (port.available() < HEADER_SIZE)
+        if (port.available() == 0)
         {
-            const TickType_t maxBlockingTime = pdMS_TO_TICKS(1000);
-            ulTaskNotifyTakeIndexed(0, pdTRUE, maxBlockingTime);
-
-            // We were woken by an interrupt, but there's not enough data available
-            // yet on the serial port for us to start processing it as a packet.
-            if (port.available() < HEADER_SIZE)
-                return false;
+            // Sleep until the UART driver / rx GPIO interrupt signals more data, or the in-flight command's
+            // response deadline passes (at most 1s, so the watchdog can be fed).
+            hal::wait_for_notification(timeoutMs);
         }
 
-        // Scan for the start of an Ecodan packet.
-        if (port.peek() != HEADER_MAGIC_A)
-        {
-            log_web_ratelimit(F("Dropping serial data, header magic mismatch"));
-            resync_rx();
-            return false;
-        }
+        unsigned long startMicros = micros();
+        uint64_t droppedBefore = rxParser.dropped_bytes();
+        bool complete = false;
 
-        if (port.readBytes(msg.buffer(), HEADER_SIZE) < HEADER_SIZE)
+        while (!complete && port.available() > 0)
         {
-            log_web(F("Serial port header read failure!"));
-            resync_rx();
-            return false;
+            complete = rxParser.consume(port.read(), msg);
         }
 
-        msg.increment_write_offset(HEADER_SIZE);
-
-        if (!msg.verify_header())
+        if (rxParser.dropped_bytes() != droppedBefore)
         {
-            log_web(F("Serial port message appears invalid, skipping payload wait..."));
-            resync_rx();
-            return false;
-        }
-
-        // It shouldn't take long to receive the rest of the payload after we get the header.
-        size_t remainingBytes = msg.payload_size() + CHECKSUM_SIZE;
-        auto startTime = std::chrono::steady_clock::now();
-        while (port.available() < remainingBytes)
-        {
-            delay(1);
-
-            if (std::chrono::steady_clock::now() - startTime > std::chrono::seconds(30))
-            {
-                log_web(F("Serial port message could not be received within 30s (got %u / %u bytes)"), port.available(), remainingBytes);
-                resync_rx();
-                return false;
-            }
-        }
-
-        if (port.readBytes(msg.payload(), remainingBytes) < remainingBytes)
-        {
-            log_web(F("Serial port payload read failure!"));
-            resync_rx();
-            return false;
+            log_web_ratelimit(F("Dropped %llu bytes of serial data while scanning for a valid frame"), rxParser.dropped_bytes() - droppedBefore);
         }
 
-        msg.increment_write_offset(msg.payload_size()); // Don't count checksum byte.
+        rxBusyMicros += micros() - startMicros;
 
-        if (!msg.verify_checksum())
-        {
-            resync_rx();
+        if (!complete)
             return false;
-        }
 
         auto& config = config_instance();
-        if (config.DumpPackets)
+        if (config.CapturePackets)
         {
-            msg.debug_dump_packet();
+            capture::record(capture::Direction::RX, msg.buffer(), msg.size());
         }
 
         ++rxMsgCount;
@@ -168,80 +283,387 @@ namespace ehal::hp
         return true;
     }
 
+    CommandCounters& counters_for(const Message& cmd)
+    {
+        return commandCounters[static_cast<uint16_t>(cmd.type()) << 8 | cmd.payload_type<uint8_t>()];
+    }
+
+    // Requires cmdQueueMutex.
+    void enqueue_cmd_locked(Message&& cmd, std::chrono::steady_clock::time_point requestedAt = std::chrono::steady_clock::now())
+    {
+        bool isSet = cmd.type() == MsgType::SET_CMD;
+        auto& queue = isSet ? setCmdQueue : getCmdQueue;
+        auto& counters = isSet ? setQueueCounters : getQueueCounters;
+
+        if (is_zone_temperature_cmd(cmd))
+            ++queuedZoneTemperatureSets;
+
+        queue.emplace(std::move(cmd), requestedAt);
+        counters.MaxDepth = std::max<uint32_t>(counters.MaxDepth, queue.size());
+    }
+
+    // Sends the next queued command, if nothing is awaiting a response. Requires cmdQueueMutex.
+    bool dispatch_next_cmd_locked()
+    {
+        if (inFlight.Active)
+            return true;
+
+        bool isSet = !setCmdQueue.empty();
+        auto& queue = isSet ? setCmdQueue : getCmdQueue;
+        auto& counters = isSet ? setQueueCounters : getQueueCounters;
+
+        if (queue.empty())
+            return true;
+
+        auto now = std::chrono::steady_clock::now();
+        auto waitMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - queue.front().QueuedAt).count();
+        ++counters.Count;
+        counters.TotalWaitMs += waitMs;
+        counters.MaxWaitMs = std::max<uint32_t>(counters.MaxWaitMs, waitMs);
+
+        inFlight.Msg = std::move(queue.front().Msg);
+        inFlight.RequestedAt = queue.front().RequestedAt;
+        inFlight.Readback = queue.front().Readback;
+        queue.pop();
+
+        inFlight.Active = true;
+        inFlight.Retransmits = 0;
+        inFlight.SentAt = now;
+
+        if (!serial_tx(inFlight.Msg))
+        {
+            log_web(F("Unable to dispatch status update request, flushing queued requests..."));
+
+            clear_command_queue_locked();
+            connected = false;
+            return false;
+        }
+
+        return true;
+    }
+
     bool dispatch_next_cmd()
     {
-        Message msg;
+        std::lock_guard<std::mutex> lock{cmdQueueMutex};
+        return dispatch_next_cmd_locked();
+    }
+
+    // Queues settings changed together, as few frames as possible. Requires cmdQueueMutex.
+    void enqueue_merged_locked(std::vector<QueuedCommand>&& cmds)
+    {
+        mergedSetCount += merge_settings(cmds);
+
+        for (auto& frame : cmds)
+            enqueue_cmd_locked(std::move(frame.Msg), frame.RequestedAt);
+    }
+
+    // Requires cmdQueueMutex.
+    std::vector<PendingSetting>::iterator find_pending_setting_locked(Setting setting)
+    {
+        return find_pending_setting(pendingSettings, setting);
+    }
+
+    // Holds a setting for the coalescing window, or replaces the one already held for it. Returns false if
+    // the setting was queued straight away instead (no window), and needs dispatching. Requires cmdQueueMutex.
+    bool hold_setting_locked(Setting setting, Message&& cmd)
+    {
+        switch (hold_pending_setting(pendingSettings, setting, cmd, std::chrono::steady_clock::now(), config_instance().SetCoalesceMs))
+        {
+        case HoldResult::REPLACED:
+            ++coalescedSetCount;
+            return true;
+        case HoldResult::HELD:
+            return true;
+        case HoldResult::NOT_HELD:
+        default:
+            enqueue_cmd_locked(std::move(cmd));
+            return false;
+        }
+    }
+
+    bool queue_setting(Setting setting, Message&& cmd)
+    {
         {
             std::lock_guard<std::mutex> lock{cmdQueueMutex};
 
-            if (cmdQueue.empty())
-            {
+            if (hold_setting_locked(setting, std::move(cmd)))
+                return true;
+        }
+
+        return dispatch_next_cmd();
+    }
+
+    // Queues the settings whose coalescing window has closed, in the order they were changed.
+    bool release_pending_settings()
+    {
+        {
+            std::lock_guard<std::mutex> lock{cmdQueueMutex};
+
+            std::vector<QueuedCommand> released = take_due_settings(pendingSettings, std::chrono::steady_clock::now());
+            if (released.empty())
                 return true;
+
+            enqueue_merged_locked(std::move(released));
+        }
+
+        return dispatch_next_cmd();
+    }
+
+    // Queues the read-backs of an acknowledged setting (see readback_cmds()). They go out with the settings,
+    // ahead of polling, and stand in for those registers' next poll. Requires cmdQueueMutex.
+    void queue_readbacks_locked(Message& cmd, std::chrono::steady_clock::time_point requestedAt)
+    {
+        auto now = std::chrono::steady_clock::now();
+
+        for (auto& readback : readback_cmds(cmd, requestedAt))
+        {
+            for (auto& poll : pollSchedule)
+            {
+                if (poll.Type == readback.Msg.payload_type<GetType>())
+                    poll.Due = now + std::chrono::milliseconds(poll.IntervalMs);
             }
 
-            msg = std::move(cmdQueue.front());
-            cmdQueue.pop();
+            setCmdQueue.push(std::move(readback));
         }
 
-        if (!serial_tx(msg))
+        setQueueCounters.MaxDepth = std::max<uint32_t>(setQueueCounters.MaxDepth, setCmdQueue.size());
+    }
+
+    void record_confirm_latency_locked(std::chrono::steady_clock::time_point requestedAt)
+    {
+        auto latencyMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - requestedAt).count();
+
+        size_t bucket = 0;
+        while (bucket < ConfirmLatencyHistogram::BUCKETS - 1 && latencyMs >= ConfirmLatencyHistogram::UPPER_BOUND_MS[bucket])
+            ++bucket;
+
+        ++confirmLatencyCounts[bucket];
+    }
+
+    // Matches a response against the in-flight command, and moves on to the next queued command.
+    void complete_in_flight_cmd(const Message& res)
+    {
+        std::lock_guard<std::mutex> lock{cmdQueueMutex};
+
+        if (!inFlight.Active || !res.is_response_to(inFlight.Msg))
         {
-            log_web(F("Unable to dispatch status update request, flushing queued requests..."));
+            log_web_ratelimit(F("Received unsolicited response: %#x (%#x)"), static_cast<uint8_t>(res.type()), res.payload_type<uint8_t>());
+            return;
+        }
 
-            clear_command_queue();
+        auto rtt = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - inFlight.SentAt).count();
+        CommandCounters& counters = counters_for(inFlight.Msg);
+        ++counters.Count;
+        counters.TotalRttMs += rtt;
+        counters.MaxRttMs = std::max<uint32_t>(counters.MaxRttMs, rtt);
 
-            connected = false;
-            return false;
+        if (inFlight.Msg.type() == MsgType::SET_CMD)
+            queue_readbacks_locked(inFlight.Msg, inFlight.RequestedAt);
+        else if (inFlight.Readback)
+            record_confirm_latency_locked(inFlight.RequestedAt);
+
+        retire_in_flight_cmd_locked();
+
+        if (!dispatch_next_cmd_locked())
+        {
+            log_web(F("Failed to dispatch status update command!"));
         }
+    }
 
-        return true;
+    // Retransmits the in-flight command if its response is overdue, giving up after CMD_MAX_RETRANSMITS.
+    // Returns the number of milliseconds until the next response deadline (or 1000 when idle).
+    uint32_t check_in_flight_timeout()
+    {
+        std::lock_guard<std::mutex> lock{cmdQueueMutex};
+
+        if (!inFlight.Active)
+            return 1000;
+
+        auto now = std::chrono::steady_clock::now();
+        auto deadline = inFlight.SentAt + std::chrono::milliseconds(CMD_RESPONSE_TIMEOUT_MS);
+        if (now < deadline)
+            return std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1;
+
+        CommandCounters& counters = counters_for(inFlight.Msg);
+        if (inFlight.Retransmits < CMD_MAX_RETRANSMITS)
+        {
+            ++inFlight.Retransmits;
+            ++counters.Retransmits;
+            inFlight.SentAt = now;
+
+            log_web_ratelimit(F("No response to command %#x (%#x), retransmitting (%u/%u)"),
+                              static_cast<uint8_t>(inFlight.Msg.type()), inFlight.Msg.payload_type<uint8_t>(), inFlight.Retransmits, CMD_MAX_RETRANSMITS);
+
+            if (serial_tx(inFlight.Msg))
+                return CMD_RESPONSE_TIMEOUT_MS;
+        }
+
+        log_web(F("Command %#x (%#x) failed after %u retransmits, skipping"),
+                static_cast<uint8_t>(inFlight.Msg.type()), inFlight.Msg.payload_type<uint8_t>(), inFlight.Retransmits);
+
+        ++counters.Failures;
+        retire_in_flight_cmd_locked();
+        dispatch_next_cmd_locked();
+        return CMD_RESPONSE_TIMEOUT_MS;
     }
 
-    bool begin_get_status()
+    // Applies "type=seconds" overrides (e.g. "02=5,a1=1800") from the Poll Intervals setting, then
+    // stretches every interval evenly if the schedule would need more than the bus utilization cap.
+    void configure_poll_schedule(const String& overrides)
     {
+        unsigned int start = 0;
+        while (start < overrides.length())
         {
-            std::unique_lock<std::mutex> lock{cmdQueueMutex, std::try_to_lock};
+            int end = overrides.indexOf(',', start);
+            if (end < 0)
+                end = overrides.length();
+
+            String entry = overrides.substring(start, end);
+            entry.trim();
+            start = end + 1;
+
+            int separator = entry.indexOf('=');
+            if (separator <= 0)
+            {
+                if (entry.length() > 0)
+                    log_web(F("Ignoring invalid poll interval: %s"), entry.c_str());
+                continue;
+            }
+
+            String typeText = entry.substring(0, separator);
+            String intervalText = entry.substring(separator + 1);
+            typeText.trim();
+            intervalText.trim();
+
+            char* typeEnd = nullptr;
+            char* intervalEnd = nullptr;
+            unsigned long type = strtoul(typeText.c_str(), &typeEnd, 16);
+            long intervalS = strtol(intervalText.c_str(), &intervalEnd, 10);
+            if (typeText.length() == 0 || *typeEnd != '\0' || type > UINT8_MAX || intervalText.length() == 0 || *intervalEnd != '\0' || intervalS < 0)
+            {
+                log_web(F("Ignoring invalid poll interval: %s"), entry.c_str());
+                continue;
+            }
 
-            if (!lock)
+            if (intervalS != 0 && (intervalS < POLL_INTERVAL_MIN_S || intervalS > POLL_INTERVAL_MAX_S))
             {
-                log_web(F("Unable to acquire lock for status query, owned by another thread!"));
-                delay(1);
+                intervalS = std::clamp<long>(intervalS, POLL_INTERVAL_MIN_S, POLL_INTERVAL_MAX_S);
+                log_web(F("Poll interval out of range, using %lds: %s"), intervalS, entry.c_str());
             }
 
-            if (!cmdQueue.empty())
+            bool found = false;
+            for (auto& poll : pollSchedule)
+            {
+                if (static_cast<uint8_t>(poll.Type) == type)
+                {
+                    poll.IntervalMs = static_cast<uint32_t>(intervalS) * 1000;
+                    found = true;
+                }
+            }
+
+            if (!found)
+                log_web(F("Ignoring poll interval for unknown register: %s"), entry.c_str());
+        }
+
+        float utilization = 0.0f;
+        for (const auto& poll : pollSchedule)
+        {
+            if (poll.IntervalMs != 0)
+                utilization += static_cast<float>(POLL_COST_MS) / poll.IntervalMs;
+        }
+
+        float cap = POLL_BUS_UTILIZATION_PERCENT / 100.0f;
+        if (utilization > cap)
+        {
+            float scale = utilization / cap;
+            log_web(F("Poll intervals need %.0f%% of the serial bus, stretching them by %.2fx"), utilization * 100.0f, scale);
+
+            for (auto& poll : pollSchedule)
+                poll.IntervalMs = static_cast<uint32_t>(poll.IntervalMs * scale);
+        }
+    }
+
+    // Queues the most overdue register, one at a time, so fast-changing registers interleave with slow
+    // ones and the scheduler always picks from up-to-date deadlines.
+    bool schedule_next_poll()
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (now < nextPollSlot)
+            return true;
+
+        {
+            std::lock_guard<std::mutex> lock{cmdQueueMutex};
+
+            if (!getCmdQueue.empty())
+                return true;
+
+            PollSchedule* next = nullptr;
+            for (auto& poll : pollSchedule)
             {
-                log_web(F("command queue was not empty when queueing status query: %u"), cmdQueue.size());
+                if (poll.IntervalMs == 0 || poll.Due > now)
+                    continue;
 
-                while (!cmdQueue.empty())
-                    cmdQueue.pop();
+                if (next == nullptr || poll.Due < next->Due)
+                    next = &poll;
             }
 
-            cmdQueue.emplace(MsgType::GET_CMD, GetType::DEFROST_STATE);
-            cmdQueue.emplace(MsgType::GET_CMD, GetType::COMPRESSOR_FREQUENCY);
-            cmdQueue.emplace(MsgType::GET_CMD, GetType::FORCED_DHW_STATE);
-            cmdQueue.emplace(MsgType::GET_CMD, GetType::HEATING_POWER);
-            cmdQueue.emplace(MsgType::GET_CMD, GetType::TEMPERATURE_CONFIG);
-            cmdQueue.emplace(MsgType::GET_CMD, GetType::SH_TEMPERATURE_STATE);
-            cmdQueue.emplace(MsgType::GET_CMD, GetType::DHW_TEMPERATURE_STATE_A);
-            cmdQueue.emplace(MsgType::GET_CMD, GetType::DHW_TEMPERATURE_STATE_B);
-            // cmdQueue.emplace(MsgType::GET_CMD, GetType::ACTIVE_TIME);
-            cmdQueue.emplace(MsgType::GET_CMD, GetType::FLOW_RATE);
-            cmdQueue.emplace(MsgType::GET_CMD, GetType::MODE_FLAGS_A);
-            cmdQueue.emplace(MsgType::GET_CMD, GetType::MODE_FLAGS_B);
-            cmdQueue.emplace(MsgType::GET_CMD, GetType::ENERGY_USAGE);
-            cmdQueue.emplace(MsgType::GET_CMD, GetType::ENERGY_DELIVERY);
+            if (next == nullptr)
+                return true;
+
+            enqueue_cmd_locked(Message{MsgType::GET_CMD, next->Type});
+            next->Due = now + std::chrono::milliseconds(next->IntervalMs);
+            nextPollSlot = now + std::chrono::milliseconds(POLL_SLOT_MS);
         }
 
         return dispatch_next_cmd();
     }
 
+    // A poll cycle is complete once no status reads are queued, on the wire, or due by the next poll slot
+    // (registers polled together drift apart by a slot each, so this keeps them in the same cycle).
+    bool poll_cycle_complete()
+    {
+        std::lock_guard<std::mutex> lock{cmdQueueMutex};
+
+        if (!getCmdQueue.empty())
+            return false;
+
+        if (inFlight.Active && inFlight.Msg.type() == MsgType::GET_CMD)
+            return false;
+
+        auto nextSlot = std::chrono::steady_clock::now() + std::chrono::milliseconds(POLL_SLOT_MS);
+        for (const auto& poll : pollSchedule)
+        {
+            if (poll.IntervalMs != 0 && poll.Due <= nextSlot)
+                return false;
+        }
+
+        return true;
+    }
+
     String get_device_model()
     {
         return F("Ecodan Air Source Heat Pump");
     }
 
-    Status& get_status()
+    Status get_status()
     {
-        return status;
+        Status copy;
+
+        while (true)
+        {
+            uint32_t before = statusSeq.load(std::memory_order_acquire);
+            if (before & 1)
+            {
+                std::this_thread::yield(); // Write in progress.
+                continue;
+            }
+
+            memcpy(&copy, &status, sizeof(copy));
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (statusSeq.load(std::memory_order_relaxed) == before)
+                return copy;
+        }
     }
 
     float get_temperature_step()
@@ -259,7 +681,32 @@ namespace ehal::hp
         return 28.0f;
     }
 
-    bool set_z1_target_temperature(float newTemp)
+    // From FTC6 installation manual ("DHW max. temp.")
+    float get_min_dhw_temperature()
+    {
+        return 40.0f;
+    }
+
+    float get_max_dhw_temperature()
+    {
+        return 60.0f;
+    }
+
+    // From FTC6 installation manual ("Zone heating/cooling min. temp.")
+    float get_min_flow_target_temperature(String mode)
+    {
+        String coolMode = "Cool Flow Temperature";
+        return (coolMode == mode) ? 5.0f : 20.0f;
+    }
+
+    float get_max_flow_target_temperature(String mode)
+    {
+        String coolMode = "Cool Flow Temperature";
+        return (coolMode == mode) ? 25.0f : 60.0f;
+    }
+
+    // The *_cmd functions validate a setting and build its SET_CMD, without sending it.
+    bool z1_target_temperature_cmd(float newTemp, Message& cmd)
     {
         if (newTemp > get_max_thermostat_temperature())
         {
@@ -273,26 +720,14 @@ namespace ehal::hp
             return false;
         }
 
-        Message cmd{MsgType::SET_CMD, SetType::BASIC_SETTINGS};
+        cmd = Message{MsgType::SET_CMD, SetType::BASIC_SETTINGS};
         cmd[1] = SET_SETTINGS_FLAG_ZONE_TEMPERATURE;
         cmd[2] = static_cast<uint8_t>(SetZone::ZONE_1);
         cmd.set_float16(newTemp, 10);
-
-        {
-            std::lock_guard<std::mutex> lock{cmdQueueMutex};
-            cmdQueue.emplace(std::move(cmd));
-        }
-
-        if (!dispatch_next_cmd())
-        {
-            log_web(F("command dispatch failed for z1 temperature setting!"));
-            return false;
-        }
-
         return true;
     }
 
-    bool set_z2_target_temperature(float newTemp)
+    bool z2_target_temperature_cmd(float newTemp, float z1Temp, Message& cmd)
     {
         if (newTemp > get_max_thermostat_temperature())
         {
@@ -308,76 +743,193 @@ namespace ehal::hp
 
         // Using SetZone::ZONE_2 seems to reset Zone1 to zero therefore we set both at the same time.
         // SetZone::ZONE_2 is labelled as (Probably) in the CN105 docs so we dont trust it
-        Message cmd{MsgType::SET_CMD, SetType::BASIC_SETTINGS};
+        cmd = Message{MsgType::SET_CMD, SetType::BASIC_SETTINGS};
         cmd[1] = SET_SETTINGS_FLAG_ZONE_TEMPERATURE;
         cmd[2] = static_cast<uint8_t>(SetZone::BOTH);
-        cmd.set_float16(status.Zone1SetTemperature, 10);
+        cmd.set_float16(z1Temp, 10);
         cmd.set_float16(newTemp, 12);
+        return true;
+    }
+
+    // Builds the zone temperature SET_CMD for a change to one or both zones. A zone which isn't changed keeps
+    // the last target requested for it, if the heat pump hasn't reported it back yet, so that a held frame can
+    // simply be replaced and every frame carries the latest target for both zones. Requires cmdQueueMutex.
+    bool zone_temperature_cmd_locked(std::optional<float> z1Temp, std::optional<float> z2Temp, Message& cmd)
+    {
+        if (!z1Temp)
+            z1Temp = requestedZone1Temperature;
+        if (!z2Temp)
+            z2Temp = requestedZone2Temperature;
+
+        if (z2Temp)
+            return z2_target_temperature_cmd(*z2Temp, z1Temp.value_or(get_status().Zone1SetTemperature), cmd);
+
+        return z1Temp && z1_target_temperature_cmd(*z1Temp, cmd);
+    }
+
+    // Notes the targets a zone temperature SET_CMD carries, once it is held or queued. Requires cmdQueueMutex.
+    void note_requested_zone_temperatures_locked(Message& cmd)
+    {
+        SetZone zone = static_cast<SetZone>(cmd[2]);
+        if (zone == SetZone::ZONE_1 || zone == SetZone::BOTH)
+            requestedZone1Temperature = cmd.get_float16(10);
+        if (zone == SetZone::BOTH)
+            requestedZone2Temperature = cmd.get_float16(12);
+    }
+
+    // Forgets the requested zone targets once the status reflects all of them: only one command is outstanding
+    // at a time, so a zone temperature read with no zone temperature SET_CMD held, queued or in flight was
+    // requested after the last one was acknowledged.
+    void forget_confirmed_zone_temperatures()
+    {
+        std::lock_guard<std::mutex> lock{cmdQueueMutex};
+
+        if (queuedZoneTemperatureSets == 0 && find_pending_setting_locked(Setting::ZONE_TEMPERATURE) == std::end(pendingSettings))
+        {
+            requestedZone1Temperature.reset();
+            requestedZone2Temperature.reset();
+        }
+    }
 
+    // Validates and holds a change to one or both zones' room temperatures.
+    bool queue_zone_temperature(std::optional<float> z1Temp, std::optional<float> z2Temp)
+    {
         {
             std::lock_guard<std::mutex> lock{cmdQueueMutex};
-            cmdQueue.emplace(std::move(cmd));
+
+            Message cmd;
+            if (!zone_temperature_cmd_locked(z1Temp, z2Temp, cmd))
+                return false;
+
+            note_requested_zone_temperatures_locked(cmd);
+            if (hold_setting_locked(Setting::ZONE_TEMPERATURE, std::move(cmd)))
+                return true;
         }
 
-        if (!dispatch_next_cmd())
+        return dispatch_next_cmd();
+    }
+
+    bool flow_target_temperature_cmd(SetZone zone, float newTemp, const String& mode, Message& cmd)
+    {
+        const char* zoneName = zone == SetZone::ZONE_1 ? "Z1" : "Z2";
+
+        if (newTemp > get_max_flow_target_temperature(mode))
         {
-            log_web(F("command dispatch failed for z2 temperature setting!"));
+            log_web(F("%s flow temperature setting exceeds maximum allowed (%s)!"), zoneName, String(get_max_flow_target_temperature(mode)).c_str());
+            return false;
+        }
+
+        if (newTemp < get_min_flow_target_temperature(mode))
+        {
+            log_web(F("%s flow temperature setting is lower than minimum allowed (%s)!"), zoneName, String(get_min_flow_target_temperature(mode)).c_str());
+            return false;
+        }
+
+        cmd = Message{MsgType::SET_CMD, SetType::BASIC_SETTINGS};
+        cmd[1] = SET_SETTINGS_FLAG_ZONE_TEMPERATURE;
+        cmd[2] = static_cast<uint8_t>(zone);
+        cmd[6] = static_cast<uint8_t>(SetHpMode::FLOW_CONTROL_MODE);
+        cmd.set_float16(newTemp, 10);
+        return true;
+    }
+
+    bool dhw_target_temperature_cmd(float newTemp, Message& cmd)
+    {
+        if (newTemp > get_max_dhw_temperature())
+        {
+            log_web(F("DHW setting exceeds maximum allowed (%s)!"), String(get_max_dhw_temperature()).c_str());
+            return false;
+        }
+
+        if (newTemp < get_min_dhw_temperature())
+        {
+            log_web(F("DHW setting is lower than minimum allowed (%s)!"), String(get_min_dhw_temperature()).c_str());
             return false;
         }
 
+        cmd = Message{MsgType::SET_CMD, SetType::BASIC_SETTINGS};
+        cmd[1] = SET_SETTINGS_FLAG_DHW_TEMPERATURE;
+        cmd.set_float16(newTemp, 8);
         return true;
     }
 
-    // From FTC6 installation manual ("DHW max. temp.")
-    float get_min_dhw_temperature()
+    bool dhw_force_cmd(bool on, Message& cmd)
     {
-        return 40.0f;
+        cmd = Message{MsgType::SET_CMD, SetType::DHW_SETTING};
+        cmd[1] = SET_SETTINGS_FLAG_MODE_TOGGLE;
+        cmd[3] = on ? 1 : 0; // bit[3] of payload is DHW force, bit[2] is Holiday mode.
+        return true;
     }
 
-    float get_max_dhw_temperature()
+    // "off" is sent as a DHW force off (DHW_FORCE), "performance"/"eco" as a DHW mode (DHW_MODE).
+    bool dhw_mode_cmd(const String& mode, Setting& setting, Message& cmd)
     {
-        return 60.0f;
+        Status::DhwMode dhwMode = Status::DhwMode::NORMAL;
+
+        if (mode == "off")
+        {
+            setting = Setting::DHW_FORCE;
+            return dhw_force_cmd(false, cmd);
+        }
+        else if (mode == "performance")
+            dhwMode = Status::DhwMode::NORMAL;
+        else if (mode == "eco")
+            dhwMode = Status::DhwMode::ECO;
+        else
+            return false;
+
+        setting = Setting::DHW_MODE;
+        cmd = Message{MsgType::SET_CMD, SetType::BASIC_SETTINGS};
+        cmd[1] = SET_SETTINGS_FLAG_DHW_MODE;
+        cmd[5] = static_cast<uint8_t>(dhwMode);
+        return true;
     }
 
-    // From FTC6 installation manual ("Zone heating/cooling min. temp.")
-    float get_min_flow_target_temperature(String mode)
+    bool power_mode_cmd(bool on, Message& cmd)
     {
-        String coolMode = "Cool Flow Temperature";
-        return (coolMode == mode) ? 5.0f : 20.0f;
+        cmd = Message{MsgType::SET_CMD, SetType::BASIC_SETTINGS};
+        cmd[1] = SET_SETTINGS_FLAG_MODE_TOGGLE;
+        cmd[3] = on ? 1 : 0;
+        return true;
     }
 
-    float get_max_flow_target_temperature(String mode)
+    bool hp_mode_cmd(uint8_t mode, Message& cmd)
     {
-        String coolMode = "Cool Flow Temperature";
-        return (coolMode == mode) ? 25.0f : 60.0f;
+        cmd = Message{MsgType::SET_CMD, SetType::BASIC_SETTINGS};
+        cmd[1] = SET_SETTINGS_FLAG_HP_MODE;
+        cmd[6] = mode;
+        return true;
     }
 
-    bool set_z1_flow_target_temperature(float newTemp)
+    bool set_z1_target_temperature(float newTemp)
     {
-        if (newTemp > get_max_flow_target_temperature(status.hp_mode_as_string()))
+        if (!queue_zone_temperature(newTemp, std::nullopt))
         {
-            log_web(F("Z1 flow temperature setting exceeds maximum allowed (%s)!"), String(get_max_flow_target_temperature(status.hp_mode_as_string())).c_str());
+            log_web(F("command dispatch failed for z1 temperature setting!"));
             return false;
         }
 
-        if (newTemp < get_min_flow_target_temperature(status.hp_mode_as_string()))
+        return true;
+    }
+
+    bool set_z2_target_temperature(float newTemp)
+    {
+        if (!queue_zone_temperature(std::nullopt, newTemp))
         {
-            log_web(F("Z1 flow temperature setting is lower than minimum allowed (%s)!"), String(get_min_flow_target_temperature(status.hp_mode_as_string())).c_str());
+            log_web(F("command dispatch failed for z2 temperature setting!"));
             return false;
         }
 
-        Message cmd{MsgType::SET_CMD, SetType::BASIC_SETTINGS};
-        cmd[1] = SET_SETTINGS_FLAG_ZONE_TEMPERATURE;
-        cmd[2] = static_cast<uint8_t>(SetZone::ZONE_1);
-        cmd[6] = static_cast<uint8_t>(SetHpMode::FLOW_CONTROL_MODE);
-        cmd.set_float16(newTemp, 10);
+        return true;
+    }
 
-        {
-            std::lock_guard<std::mutex> lock{cmdQueueMutex};
-            cmdQueue.emplace(std::move(cmd));
-        }
+    bool set_z1_flow_target_temperature(float newTemp)
+    {
+        Message cmd;
+        if (!flow_target_temperature_cmd(SetZone::ZONE_1, newTemp, get_status().hp_mode_as_string(), cmd))
+            return false;
 
-        if (!dispatch_next_cmd())
+        if (!queue_setting(Setting::Z1_FLOW_TEMPERATURE, std::move(cmd)))
         {
             log_web(F("command dispatch failed for Z1 flow target temperature setting!"));
             return false;
@@ -388,154 +940,204 @@ namespace ehal::hp
 
     bool set_z2_flow_target_temperature(float newTemp)
     {
-        if (newTemp > get_max_flow_target_temperature(status.hp_mode_as_string()))
-        {
-            log_web(F("Z2 flow temperature setting exceeds maximum allowed (%s)!"), String(get_max_flow_target_temperature(status.hp_mode_as_string())).c_str());
+        Message cmd;
+        if (!flow_target_temperature_cmd(SetZone::ZONE_2, newTemp, get_status().hp_mode_as_string(), cmd))
             return false;
-        }
 
-        if (newTemp < get_min_flow_target_temperature(status.hp_mode_as_string()))
+        if (!queue_setting(Setting::Z2_FLOW_TEMPERATURE, std::move(cmd)))
         {
-            log_web(F("Z2 flow temperature setting is lower than minimum allowed (%s)!"), String(get_min_flow_target_temperature(status.hp_mode_as_string())).c_str());
+            log_web(F("command dispatch failed for Z2 flow target temperature setting!"));
             return false;
         }
 
-        Message cmd{MsgType::SET_CMD, SetType::BASIC_SETTINGS};
-        cmd[1] = SET_SETTINGS_FLAG_ZONE_TEMPERATURE;
-        cmd[2] = static_cast<uint8_t>(SetZone::ZONE_2);
-        cmd[6] = static_cast<uint8_t>(SetHpMode::FLOW_CONTROL_MODE);
-        cmd.set_float16(newTemp, 10);
+        return true;
+    }
 
-        {
-            std::lock_guard<std::mutex> lock{cmdQueueMutex};
-            cmdQueue.emplace(std::move(cmd));
-        }
+    bool set_dhw_target_temperature(float newTemp)
+    {
+        Message cmd;
+        if (!dhw_target_temperature_cmd(newTemp, cmd))
+            return false;
 
-        if (!dispatch_next_cmd())
+        if (!queue_setting(Setting::DHW_TEMPERATURE, std::move(cmd)))
         {
-            log_web(F("command dispatch failed for Z2 flow target temperature setting!"));
+            log_web(F("command dispatch failed for DHW temperature setting!"));
             return false;
         }
 
         return true;
     }
 
-    bool set_dhw_target_temperature(float newTemp)
+    bool set_dhw_mode(String mode)
     {
-        if (newTemp > get_max_dhw_temperature())
-        {
-            log_web(F("DHW setting exceeds maximum allowed (%s)!"), String(get_max_dhw_temperature()).c_str());
+        Setting setting;
+        Message cmd;
+        if (!dhw_mode_cmd(mode, setting, cmd))
             return false;
-        }
 
-        if (newTemp < get_min_dhw_temperature())
+        if (!queue_setting(setting, std::move(cmd)))
         {
-            log_web(F("DHW setting is lower than minimum allowed (%s)!"), String(get_min_dhw_temperature()).c_str());
+            log_web(F("command dispatch failed for DHW mode setting!"));
             return false;
         }
 
-        Message cmd{MsgType::SET_CMD, SetType::BASIC_SETTINGS};
-        cmd[1] = SET_SETTINGS_FLAG_DHW_TEMPERATURE;
-        cmd.set_float16(newTemp, 8);
+        return true;
+    }
 
-        {
-            std::lock_guard<std::mutex> lock{cmdQueueMutex};
-            cmdQueue.emplace(std::move(cmd));
-        }
+    bool set_dhw_force(bool on)
+    {
+        Message cmd;
+        dhw_force_cmd(on, cmd);
 
-        if (!dispatch_next_cmd())
+        if (!queue_setting(Setting::DHW_FORCE, std::move(cmd)))
         {
-            log_web(F("command dispatch failed for DHW temperature setting!"));
+            log_web(F("command dispatch failed for DHW force setting!"));
             return false;
         }
 
         return true;
     }
 
-    bool set_dhw_mode(String mode)
+    bool set_power_mode(bool on)
     {
-        Status::DhwMode dhwMode = Status::DhwMode::NORMAL;
+        Message cmd;
+        power_mode_cmd(on, cmd);
 
-        if (mode == "off")
-            return set_dhw_force(false);
-        else if (mode == "performance")
-            dhwMode = Status::DhwMode::NORMAL;
-        else if (mode == "eco")
-            dhwMode = Status::DhwMode::ECO;
-        else
+        if (!queue_setting(Setting::POWER_MODE, std::move(cmd)))
+        {
+            log_web(F("command dispatch failed for power mode setting!"));
             return false;
+        }
 
-        Message cmd{MsgType::SET_CMD, SetType::BASIC_SETTINGS};
-        cmd[1] = SET_SETTINGS_FLAG_DHW_MODE;
-        cmd[5] = static_cast<uint8_t>(dhwMode);
+        return true;
+    }
 
-        {
-            std::lock_guard<std::mutex> lock{cmdQueueMutex};
-            cmdQueue.emplace(std::move(cmd));
-        }
+    bool set_hp_mode(uint8_t mode)
+    {
+        Message cmd;
+        hp_mode_cmd(mode, cmd);
 
-        if (!dispatch_next_cmd())
+        if (!queue_setting(Setting::HP_MODE, std::move(cmd)))
         {
-            log_web(F("command dispatch failed for DHW temperature setting!"));
+            log_web(F("command dispatch failed for heat pump mode setting!"));
             return false;
         }
 
         return true;
     }
 
-    bool set_dhw_force(bool on)
+    // Inverse of Status::hp_mode_as_string().
+    bool hp_mode_from_string(const String& mode, uint8_t& value)
     {
-        Message cmd{MsgType::SET_CMD, SetType::DHW_SETTING};
-        cmd[1] = SET_SETTINGS_FLAG_MODE_TOGGLE;
-        cmd[3] = on ? 1 : 0; // bit[3] of payload is DHW force, bit[2] is Holiday mode.
+        for (auto hpMode : {Status::HpMode::HEAT_ROOM_TEMP, Status::HpMode::HEAT_FLOW_TEMP, Status::HpMode::HEAT_COMPENSATION_CURVE,
+                            Status::HpMode::COOL_ROOM_TEMP, Status::HpMode::COOL_FLOW_TEMP})
+        {
+            Status status;
+            status.HeatingCoolingMode = hpMode;
+            if (status.hp_mode_as_string() == mode)
+            {
+                value = static_cast<uint8_t>(hpMode);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool set_settings(const SettingsChange& change)
+    {
+        // Validate everything before anything is sent, so a bad value doesn't leave the change half-applied.
+        std::vector<std::pair<Setting, Message>> cmds;
+        Message cmd;
+
+        std::unique_lock<std::mutex> lock{cmdQueueMutex};
 
+        Status status = get_status();
+        if (change.HpMode)
         {
-            std::lock_guard<std::mutex> lock{cmdQueueMutex};
-            cmdQueue.emplace(std::move(cmd));
+            hp_mode_cmd(*change.HpMode, cmd);
+            cmds.emplace_back(Setting::HP_MODE, std::move(cmd));
+            status.set_heating_cooling_mode(*change.HpMode); // Flow temperature limits depend on the new mode.
         }
 
-        if (!dispatch_next_cmd())
+        if (change.Z1Temperature || change.Z2Temperature)
         {
-            log_web(F("command dispatch failed for DHW force setting!"));
-            return false;
+            if (!zone_temperature_cmd_locked(change.Z1Temperature, change.Z2Temperature, cmd))
+                return false;
+            cmds.emplace_back(Setting::ZONE_TEMPERATURE, std::move(cmd));
         }
 
-        return true;
-    }
+        if (change.Z1FlowTemperature)
+        {
+            if (!flow_target_temperature_cmd(SetZone::ZONE_1, *change.Z1FlowTemperature, status.hp_mode_as_string(), cmd))
+                return false;
+            cmds.emplace_back(Setting::Z1_FLOW_TEMPERATURE, std::move(cmd));
+        }
 
-    bool set_power_mode(bool on)
-    {
-        Message cmd{MsgType::SET_CMD, SetType::BASIC_SETTINGS};
-        cmd[1] = SET_SETTINGS_FLAG_MODE_TOGGLE;
-        cmd[3] = on ? 1 : 0;
+        if (change.Z2FlowTemperature)
         {
-            std::lock_guard<std::mutex> lock{cmdQueueMutex};
-            cmdQueue.emplace(std::move(cmd));
+            if (!flow_target_temperature_cmd(SetZone::ZONE_2, *change.Z2FlowTemperature, status.hp_mode_as_string(), cmd))
+                return false;
+            cmds.emplace_back(Setting::Z2_FLOW_TEMPERATURE, std::move(cmd));
         }
 
-        if (!dispatch_next_cmd())
+        if (change.DhwTemperature)
         {
-            log_web(F("command dispatch failed for DHW force setting!"));
-            return false;
+            if (!dhw_target_temperature_cmd(*change.DhwTemperature, cmd))
+                return false;
+            cmds.emplace_back(Setting::DHW_TEMPERATURE, std::move(cmd));
         }
 
-        return true;
-    }
+        if (change.DhwMode)
+        {
+            Setting setting;
+            if (!dhw_mode_cmd(*change.DhwMode, setting, cmd))
+            {
+                log_web(F("Unexpected DHW mode requested: %s"), change.DhwMode->c_str());
+                return false;
+            }
+            cmds.emplace_back(setting, std::move(cmd));
+        }
 
-    bool set_hp_mode(uint8_t mode)
-    {
-        Message cmd{MsgType::SET_CMD, SetType::BASIC_SETTINGS};
-        cmd[1] = SET_SETTINGS_FLAG_HP_MODE;
-        cmd[6] = mode;
+        if (change.DhwForce)
+        {
+            dhw_force_cmd(*change.DhwForce, cmd);
+            cmds.emplace_back(Setting::DHW_FORCE, std::move(cmd));
+        }
 
+        if (change.Power)
         {
-            std::lock_guard<std::mutex> lock{cmdQueueMutex};
-            cmdQueue.emplace(std::move(cmd));
+            power_mode_cmd(*change.Power, cmd);
+            cmds.emplace_back(Setting::POWER_MODE, std::move(cmd));
+        }
+
+        if (cmds.empty())
+            return true;
+
+        auto now = std::chrono::steady_clock::now();
+        std::vector<QueuedCommand> frames;
+        for (auto& [setting, msg] : cmds)
+        {
+            // Supersedes a change to the same setting still waiting out its coalescing window.
+            auto held = find_pending_setting_locked(setting);
+            if (held != std::end(pendingSettings))
+            {
+                pendingSettings.erase(held);
+                ++coalescedSetCount;
+            }
+
+            if (setting == Setting::ZONE_TEMPERATURE)
+                note_requested_zone_temperatures_locked(msg);
+
+            frames.emplace_back(std::move(msg), now);
         }
 
+        enqueue_merged_locked(std::move(frames));
+        lock.unlock();
+
         if (!dispatch_next_cmd())
         {
-            log_web(F("command dispatch failed for heat pump mode setting!"));
+            log_web(F("command dispatch failed for settings change!"));
             return false;
         }
 
@@ -550,88 +1152,52 @@ namespace ehal::hp
         }
     }
 
+    void post_status_delta(uint64_t changedFields)
+    {
+        if (!statusDeltas.push(StatusDelta{changedFields}))
+            ++statusDeltaOverflowCount;
+
+        hal::TaskHandle consumer = statusDeltaConsumer.load();
+        if (consumer != nullptr)
+            hal::notify(consumer);
+    }
+
+    void set_status_delta_consumer(hal::TaskHandle task)
+    {
+        statusDeltaConsumer.store(task);
+    }
+
+    bool pop_status_delta(StatusDelta& delta)
+    {
+        return statusDeltas.pop(delta);
+    }
+
+    uint32_t get_status_delta_overflow_count()
+    {
+        return statusDeltaOverflowCount.load();
+    }
+
     void handle_get_response(Message& res)
     {
+        GetType type = res.payload_type<GetType>();
+        if (!has_register_fields(type) && type != GetType::ACTIVE_TIME)
         {
-            std::lock_guard<Status> lock{status};
-
-            switch (res.payload_type<GetType>())
-            {
-            case GetType::DEFROST_STATE:
-                status.DefrostActive = res[3] != 0;
-                break;
-            case GetType::COMPRESSOR_FREQUENCY:
-                status.CompressorFrequency = res[1];
-                break;
-            case GetType::FORCED_DHW_STATE:
-                status.DhwForcedActive = res[7] != 0;
-                break;
-            case GetType::HEATING_POWER:
-                status.OutputPower = res[6];
-                break;
-            case GetType::TEMPERATURE_CONFIG:
-                status.Zone1SetTemperature = res.get_float16(1);
-                status.Zone2SetTemperature = res.get_float16(3);
-                status.Zone1FlowTemperatureSetPoint = res.get_float16(5);
-                status.Zone2FlowTemperatureSetPoint = res.get_float16(7);
-                status.LegionellaPreventionSetPoint = res.get_float16(9);
-                status.DhwTemperatureDrop = res.get_float8_v2(11);
-                status.MaximumFlowTemperature = res.get_float8_v3(12);
-                status.MinimumFlowTemperature = res.get_float8_v3(13);
-                break;
-            case GetType::SH_TEMPERATURE_STATE:
-                status.Zone1RoomTemperature = res.get_float16(1);
-                if (res.get_u16(3) != 0xF0C4) // 0xF0C4 seems to be a sentinel value for "not reported in the current system"
-                    status.Zone2RoomTemperature = res.get_float16(3);
-                else
-                    status.Zone2RoomTemperature = 0.0f;
-                status.OutsideTemperature = res.get_float8(11);
-                break;
-            case GetType::DHW_TEMPERATURE_STATE_A:
-                status.DhwFeedTemperature = res.get_float16(1);
-                status.DhwReturnTemperature = res.get_float16(4);
-                status.DhwTemperature = res.get_float16(7);
-                break;
-            case GetType::DHW_TEMPERATURE_STATE_B:
-                status.BoilerFlowTemperature = res.get_float16(1);
-                status.BoilerReturnTemperature = res.get_float16(4);
-                break;
-            case GetType::ACTIVE_TIME:
-                break;
-            case GetType::FLOW_RATE:
-                status.FlowRate = res[12];
-                break;
-            case GetType::MODE_FLAGS_A:
-                status.set_power_mode(res[3]);
-                status.set_operation_mode(res[4]);
-                status.set_dhw_mode(res[5]);
-                status.set_heating_cooling_mode(res[6]);
-                status.DhwFlowTemperatureSetPoint = res.get_float16(8);
-                status.RadiatorFlowTemperatureSetPoint = res.get_float16(12);
-                break;
-            case GetType::MODE_FLAGS_B:
-                status.HolidayMode = res[4] > 0;
-                status.DhwTimerMode = res[5] > 0;
-                break;
-            case GetType::ENERGY_USAGE:
-                status.EnergyConsumedHeating = res.get_float24(4);
-                status.EnergyConsumedCooling = res.get_float24(7);
-                status.EnergyConsumedDhw = res.get_float24(10);
-                break;
-            case GetType::ENERGY_DELIVERY:
-                status.EnergyDeliveredHeating = res.get_float24(4);
-                status.EnergyDeliveredCooling = res.get_float24(7);
-                status.EnergyDeliveredDhw = res.get_float24(10);
-                break;
-            default:
-                log_web(F("Unknown response type received on serial port: %u"), static_cast<uint8_t>(res.payload_type<GetType>()));
-                break;
-            }
+            log_web(F("Unknown response type received on serial port: %u"), static_cast<uint8_t>(type));
+            return;
         }
 
-        if (!dispatch_next_cmd())
+        write_status([&](Status& s)
         {
-            log_web(F("Failed to dispatch status update command!"));
+            pollCycleChangedFields |= decode_registers(res, s);
+        });
+
+        if (type == GetType::TEMPERATURE_CONFIG)
+            forget_confirmed_zone_temperatures();
+
+        if (poll_cycle_complete())
+        {
+            post_status_delta(pollCycleChangedFields);
+            pollCycleChangedFields = 0;
         }
     }
 
@@ -649,45 +1215,62 @@ namespace ehal::hp
 
     void IRAM_ATTR serial_rx_isr()
     {
-        BaseType_t higherPriorityTaskWoken = pdFALSE;
-        vTaskNotifyGiveIndexedFromISR(serialRxTaskHandle, 0, &higherPriorityTaskWoken);
-#if CONFIG_IDF_TARGET_ESP32C3
-        portEND_SWITCHING_ISR(higherPriorityTaskWoken);
-#else
-        portYIELD_FROM_ISR(higherPriorityTaskWoken);
-#endif
+        ++rxWakeCount;
+        hal::notify_from_isr(serialRxTaskHandle);
+    }
+
+    void serial_rx_event()
+    {
+        ++rxWakeCount;
+        hal::notify(serialRxTaskHandle);
     }
 
     void serial_rx_thread()
     {
-        ehal::add_thread_to_watchdog();
+        hal::add_thread_to_watchdog();
 
-        // Wake the serial RX thread when the serial RX GPIO pin changes (this may occur during or after packet receipt)
-        serialRxTaskHandle = xTaskGetCurrentTaskHandle();
+        serialRxTaskHandle = hal::current_task();
 
         {
             auto& config = config_instance();
-            attachInterrupt(digitalPinToInterrupt(config.SerialRxPort), serial_rx_isr, FALLING);
+            if (config.UartEventRx)
+            {
+                // Let the UART driver buffer incoming bytes and wake the serial RX thread once the line
+                // goes idle after a frame (or its FIFO fills), rather than on every bit edge.
+                port.setRxFIFOFull(TOTAL_MSG_SIZE);
+                port.setRxTimeout(UART_RX_IDLE_SYMBOLS);
+                port.onReceive(serial_rx_event, /* onlyOnTimeout = */ false);
+            }
+            else
+            {
+                // Wake the serial RX thread when the serial RX GPIO pin changes (this may occur during or after packet receipt)
+                attachInterrupt(digitalPinToInterrupt(config.SerialRxPort), serial_rx_isr, FALLING);
+            }
         }
 
         while (true)
         {
             try
             {
-                ehal::ping_watchdog();
+                hal::ping_watchdog();
+
+                uint32_t timeoutMs = check_in_flight_timeout();
 
                 Message res;
-                if (!serial_rx(res))
+                if (!serial_rx(res, timeoutMs))
                 {
                     continue;
                 }
 
+                // Put the next command on the wire before decoding, so the controller can start on it.
                 switch (res.type())
                 {
                 case MsgType::SET_RES:
+                    complete_in_flight_cmd(res);
                     handle_set_response(res);
                     break;
                 case MsgType::GET_RES:
+                    complete_in_flight_cmd(res);
                     handle_get_response(res);
                     break;
                 case MsgType::CONNECT_RES:
@@ -720,6 +1303,10 @@ namespace ehal::hp
 
         delay(25); // There seems to be a window after setting the pin modes where trying to use the UART can be flaky, so introduce a short delay
 
+        configure_poll_schedule(config.PollIntervals);
+        linkStartTime = std::chrono::steady_clock::now();
+
+        port.setTxBufferSize(UART_TX_RING_SIZE);
         port.begin(2400, SERIAL_8E1, config.SerialRxPort, config.SerialTxPort);
 
         serialRxThread = std::thread{serial_rx_thread};
@@ -751,16 +1338,14 @@ namespace ehal::hp
         }
         else if (is_connected())
         {
-            // Update status the first time we enter this condition, then every 60s thereafter.
-            auto now = std::chrono::steady_clock::now();
-            static auto last_update = now - std::chrono::seconds(120);
-            if (now - last_update > std::chrono::seconds(60))
+            if (!release_pending_settings())
             {
-                last_update = now;
-                if (!begin_get_status())
-                {
-                    log_web(F("Failed to begin heatpump status update!"));
-                }
+                log_web(F("Failed to dispatch heatpump setting!"));
+            }
+
+            if (!schedule_next_poll())
+            {
+                log_web(F("Failed to begin heatpump status update!"));
             }
         }
     }
@@ -779,4 +1364,100 @@ namespace ehal::hp
     {
         return rxMsgCount;
     }
+
+    uint64_t get_rx_dropped_byte_count()
+    {
+        return rxParser.dropped_bytes();
+    }
+
+    float get_rx_wakeups_per_msg()
+    {
+        if (rxMsgCount == 0)
+            return 0.0f;
+
+        return static_cast<float>(rxWakeCount.load()) / rxMsgCount;
+    }
+
+    float get_rx_cpu_us_per_msg()
+    {
+        if (rxMsgCount == 0)
+            return 0.0f;
+
+        return static_cast<float>(rxBusyMicros) / rxMsgCount;
+    }
+
+    float get_tx_us_per_msg()
+    {
+        if (txMsgCount == 0)
+            return 0.0f;
+
+        return static_cast<float>(txBusyMicros) / txMsgCount;
+    }
+
+    uint64_t get_tx_ring_full_count()
+    {
+        return txRingFullCount;
+    }
+
+    std::vector<CommandStats> get_command_stats()
+    {
+        std::lock_guard<std::mutex> lock{cmdQueueMutex};
+
+        std::vector<CommandStats> stats;
+        stats.reserve(commandCounters.size());
+
+        for (const auto& kv : commandCounters)
+        {
+            char name[16] = {};
+            snprintf(name, sizeof(name), "%s %#04x", (kv.first >> 8) == static_cast<uint8_t>(MsgType::SET_CMD) ? "SET" : "GET", kv.first & 0xFF);
+
+            const CommandCounters& c = kv.second;
+            stats.push_back(CommandStats{
+                String(name),
+                c.Count,
+                c.Retransmits,
+                c.Failures,
+                c.Count ? static_cast<uint32_t>(c.TotalRttMs / c.Count) : 0,
+                c.MaxRttMs});
+        }
+
+        return stats;
+    }
+
+    QueueStats get_queue_stats()
+    {
+        std::lock_guard<std::mutex> lock{cmdQueueMutex};
+
+        QueueStats stats;
+        stats.SetDepth = setCmdQueue.size();
+        stats.GetDepth = getCmdQueue.size();
+        stats.MaxSetDepth = setQueueCounters.MaxDepth;
+        stats.MaxGetDepth = getQueueCounters.MaxDepth;
+        stats.AverageSetWaitMs = setQueueCounters.Count ? static_cast<uint32_t>(setQueueCounters.TotalWaitMs / setQueueCounters.Count) : 0;
+        stats.MaxSetWaitMs = setQueueCounters.MaxWaitMs;
+        stats.AverageGetWaitMs = getQueueCounters.Count ? static_cast<uint32_t>(getQueueCounters.TotalWaitMs / getQueueCounters.Count) : 0;
+        stats.MaxGetWaitMs = getQueueCounters.MaxWaitMs;
+        stats.PendingSettings = pendingSettings.size();
+        stats.CoalescedSets = coalescedSetCount;
+        stats.MergedSets = mergedSetCount;
+        return stats;
+    }
+
+    ConfirmLatencyHistogram get_confirm_latency_histogram()
+    {
+        std::lock_guard<std::mutex> lock{cmdQueueMutex};
+
+        ConfirmLatencyHistogram histogram;
+        std::copy(std::begin(confirmLatencyCounts), std::end(confirmLatencyCounts), std::begin(histogram.Counts));
+        return histogram;
+    }
+
+    float get_bus_utilization()
+    {
+        auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - linkStartTime).count();
+        if (elapsedMs == 0)
+            return 0.0f;
+
+        return (txMsgCount + rxMsgCount) * FRAME_TIME_MS * 100.0f / elapsedMs;
+    }
 } // namespace ehal::hp
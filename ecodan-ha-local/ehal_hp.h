@@ -1,8 +1,12 @@
 #pragma once
 
 #include "Arduino.h"
+#include "ehal_hal.h"
 #include <functional>
 #include <mutex>
+#include <optional>
+#include <type_traits>
+#include <vector>
 
 namespace ehal::hp
 {
@@ -221,23 +225,14 @@ namespace ehal::hp
         {
             HeatingCoolingMode = static_cast<HpMode>(mode);
         }
-
-        void lock()
-        {
-            lock_.lock();
-        }
-
-        void unlock()
-        {
-            lock_.unlock();
-        }
-
-      private:
-        std::mutex lock_;
     };
 
+    static_assert(std::is_trivially_copyable<Status>::value, "Status snapshots are copied with memcpy");
+
     String get_device_model();
-    Status& get_status();
+
+    // Returns a consistent copy of the latest status; never blocks on the serial decoder.
+    Status get_status();
 
     float get_temperature_step();
     float get_min_thermostat_temperature();
@@ -257,8 +252,73 @@ namespace ehal::hp
     bool set_power_mode(bool on);
     bool set_hp_mode(uint8_t mode);
 
+    // Several settings changed together; fields left empty are unchanged.
+    struct SettingsChange
+    {
+        std::optional<float> Z1Temperature;
+        std::optional<float> Z1FlowTemperature;
+        std::optional<float> Z2Temperature;
+        std::optional<float> Z2FlowTemperature;
+        std::optional<float> DhwTemperature;
+        std::optional<String> DhwMode; // "off", "eco" or "performance"
+        std::optional<bool> DhwForce;
+        std::optional<bool> Power;
+        std::optional<uint8_t> HpMode; // Status::HpMode
+    };
+
+    // Validates every change before sending any of them, and merges those carried by BASIC_SETTINGS
+    // into as few frames as possible (normally one). Bypasses the setting coalescing window.
+    bool set_settings(const SettingsChange& change);
+    bool hp_mode_from_string(const String& mode, uint8_t& value);
+
+    struct CommandStats
+    {
+        String Name;
+        uint32_t Count;
+        uint32_t Retransmits;
+        uint32_t Failures;
+        uint32_t AverageRttMs;
+        uint32_t MaxRttMs;
+    };
+
+    struct QueueStats
+    {
+        uint32_t SetDepth;
+        uint32_t GetDepth;
+        uint32_t MaxSetDepth;
+        uint32_t MaxGetDepth;
+        uint32_t AverageSetWaitMs;
+        uint32_t MaxSetWaitMs;
+        uint32_t AverageGetWaitMs;
+        uint32_t MaxGetWaitMs;
+        uint32_t PendingSettings; // Held for the setting coalescing window
+        uint32_t CoalescedSets; // Setting changes replaced by a later change within the window
+        uint32_t MergedSets; // SET_CMDs saved by merging settings into one BASIC_SETTINGS frame
+    };
+
+    // Time from a setting being requested to the heat pump reporting it back, see the "Setting
+    // Confirmation Latency" diagnostics. Counts[n] covers [UPPER_BOUND_MS[n-1], UPPER_BOUND_MS[n]).
+    struct ConfirmLatencyHistogram
+    {
+        static constexpr size_t BUCKETS = 6;
+        static constexpr uint32_t UPPER_BOUND_MS[BUCKETS] = {250, 500, 1000, 2000, 5000, UINT32_MAX};
+
+        uint32_t Counts[BUCKETS] = {};
+    };
+
+    // Posted each time a poll cycle completes; the consumer reads the updated status with get_status().
+    struct StatusDelta
+    {
+        uint64_t ChangedFields; // Bit n = REGISTER_FIELDS[n], set if its value changed during the cycle
+    };
+
+    // Status deltas are posted by the serial receive thread to one consumer thread, which is notified
+    // (hal::wait_for_notification) after each is posted.
+    void set_status_delta_consumer(hal::TaskHandle task);
+    bool pop_status_delta(StatusDelta& delta);
+    uint32_t get_status_delta_overflow_count();
+
     bool begin_connect();
-    bool begin_update_status();
 
     bool initialize();
     void handle_loop();
@@ -266,4 +326,13 @@ namespace ehal::hp
 
     uint64_t get_rx_msg_count();
     uint64_t get_tx_msg_count();
+    uint64_t get_rx_dropped_byte_count();
+    float get_rx_wakeups_per_msg();
+    float get_rx_cpu_us_per_msg();
+    float get_tx_us_per_msg();
+    uint64_t get_tx_ring_full_count();
+    std::vector<CommandStats> get_command_stats();
+    QueueStats get_queue_stats();
+    ConfirmLatencyHistogram get_confirm_latency_histogram();
+    float get_bus_utilization();
 } // namespace ehal::hp
\ No newline at end of file
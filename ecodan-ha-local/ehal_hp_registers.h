@@ -0,0 +1,168 @@
+#pragma once
+
+#include <type_traits>
+
+#include "ehal_hp.h"
+#include "ehal_proto.h"
+
+namespace ehal::hp
+{
+    // How a register field is packed into the GET_RES payload.
+    enum class FieldEncoding : uint8_t
+    {
+        U8,        // Raw byte
+        FLOAT8,    // (v / 2) - 40, most single-byte temperatures
+        FLOAT8_V2, // (v - 40) / 2, DHW temperature drop threshold
+        FLOAT8_V3, // v - 80, min/max SH flow temperature
+        FLOAT16,   // Big-endian u16 / 100
+        FLOAT24    // Big-endian u16 + (u8 / 100)
+    };
+
+    template <typename T>
+    struct member_type;
+
+    template <typename T>
+    struct member_type<T Status::*>
+    {
+        using type = T;
+    };
+
+    // Stores a decoded value into a Status member, returning true if the member's value changed.
+    template <auto Member>
+    bool store_field(Status& status, float value)
+    {
+        using T = typename member_type<decltype(Member)>::type;
+
+        T v;
+        if constexpr (std::is_enum_v<T>)
+            v = static_cast<T>(static_cast<std::underlying_type_t<T>>(value));
+        else
+            v = static_cast<T>(value);
+
+        if (status.*Member == v)
+            return false;
+
+        status.*Member = v;
+        return true;
+    }
+
+    struct RegisterField
+    {
+        GetType Type;
+        uint8_t Offset;
+        FieldEncoding Encoding;
+        uint16_t Sentinel; // Raw u16 at Offset meaning "not reported by this system", decoded as 0 (0 for none).
+        bool (*Store)(Status&, float);
+    };
+
+    // One row per Status member populated from a GET_RES; the row index is the field's bit in a changed mask.
+    inline constexpr RegisterField REGISTER_FIELDS[] = {
+        {GetType::DEFROST_STATE, 3, FieldEncoding::U8, 0, &store_field<&Status::DefrostActive>},
+        {GetType::COMPRESSOR_FREQUENCY, 1, FieldEncoding::U8, 0, &store_field<&Status::CompressorFrequency>},
+        {GetType::FORCED_DHW_STATE, 7, FieldEncoding::U8, 0, &store_field<&Status::DhwForcedActive>},
+        {GetType::HEATING_POWER, 6, FieldEncoding::U8, 0, &store_field<&Status::OutputPower>},
+        {GetType::TEMPERATURE_CONFIG, 1, FieldEncoding::FLOAT16, 0, &store_field<&Status::Zone1SetTemperature>},
+        {GetType::TEMPERATURE_CONFIG, 3, FieldEncoding::FLOAT16, 0, &store_field<&Status::Zone2SetTemperature>},
+        {GetType::TEMPERATURE_CONFIG, 5, FieldEncoding::FLOAT16, 0, &store_field<&Status::Zone1FlowTemperatureSetPoint>},
+        {GetType::TEMPERATURE_CONFIG, 7, FieldEncoding::FLOAT16, 0, &store_field<&Status::Zone2FlowTemperatureSetPoint>},
+        {GetType::TEMPERATURE_CONFIG, 9, FieldEncoding::FLOAT16, 0, &store_field<&Status::LegionellaPreventionSetPoint>},
+        {GetType::TEMPERATURE_CONFIG, 11, FieldEncoding::FLOAT8_V2, 0, &store_field<&Status::DhwTemperatureDrop>},
+        {GetType::TEMPERATURE_CONFIG, 12, FieldEncoding::FLOAT8_V3, 0, &store_field<&Status::MaximumFlowTemperature>},
+        {GetType::TEMPERATURE_CONFIG, 13, FieldEncoding::FLOAT8_V3, 0, &store_field<&Status::MinimumFlowTemperature>},
+        {GetType::SH_TEMPERATURE_STATE, 1, FieldEncoding::FLOAT16, 0, &store_field<&Status::Zone1RoomTemperature>},
+        {GetType::SH_TEMPERATURE_STATE, 3, FieldEncoding::FLOAT16, 0xF0C4, &store_field<&Status::Zone2RoomTemperature>},
+        {GetType::SH_TEMPERATURE_STATE, 11, FieldEncoding::FLOAT8, 0, &store_field<&Status::OutsideTemperature>},
+        {GetType::DHW_TEMPERATURE_STATE_A, 1, FieldEncoding::FLOAT16, 0, &store_field<&Status::DhwFeedTemperature>},
+        {GetType::DHW_TEMPERATURE_STATE_A, 4, FieldEncoding::FLOAT16, 0, &store_field<&Status::DhwReturnTemperature>},
+        {GetType::DHW_TEMPERATURE_STATE_A, 7, FieldEncoding::FLOAT16, 0, &store_field<&Status::DhwTemperature>},
+        {GetType::DHW_TEMPERATURE_STATE_B, 1, FieldEncoding::FLOAT16, 0, &store_field<&Status::BoilerFlowTemperature>},
+        {GetType::DHW_TEMPERATURE_STATE_B, 4, FieldEncoding::FLOAT16, 0, &store_field<&Status::BoilerReturnTemperature>},
+        {GetType::FLOW_RATE, 12, FieldEncoding::U8, 0, &store_field<&Status::FlowRate>},
+        {GetType::MODE_FLAGS_A, 3, FieldEncoding::U8, 0, &store_field<&Status::Power>},
+        {GetType::MODE_FLAGS_A, 4, FieldEncoding::U8, 0, &store_field<&Status::Operation>},
+        {GetType::MODE_FLAGS_A, 5, FieldEncoding::U8, 0, &store_field<&Status::HotWaterMode>},
+        {GetType::MODE_FLAGS_A, 6, FieldEncoding::U8, 0, &store_field<&Status::HeatingCoolingMode>},
+        {GetType::MODE_FLAGS_A, 8, FieldEncoding::FLOAT16, 0, &store_field<&Status::DhwFlowTemperatureSetPoint>},
+        {GetType::MODE_FLAGS_A, 12, FieldEncoding::FLOAT16, 0, &store_field<&Status::RadiatorFlowTemperatureSetPoint>},
+        {GetType::MODE_FLAGS_B, 4, FieldEncoding::U8, 0, &store_field<&Status::HolidayMode>},
+        {GetType::MODE_FLAGS_B, 5, FieldEncoding::U8, 0, &store_field<&Status::DhwTimerMode>},
+        {GetType::ENERGY_USAGE, 4, FieldEncoding::FLOAT24, 0, &store_field<&Status::EnergyConsumedHeating>},
+        {GetType::ENERGY_USAGE, 7, FieldEncoding::FLOAT24, 0, &store_field<&Status::EnergyConsumedCooling>},
+        {GetType::ENERGY_USAGE, 10, FieldEncoding::FLOAT24, 0, &store_field<&Status::EnergyConsumedDhw>},
+        {GetType::ENERGY_DELIVERY, 4, FieldEncoding::FLOAT24, 0, &store_field<&Status::EnergyDeliveredHeating>},
+        {GetType::ENERGY_DELIVERY, 7, FieldEncoding::FLOAT24, 0, &store_field<&Status::EnergyDeliveredCooling>},
+        {GetType::ENERGY_DELIVERY, 10, FieldEncoding::FLOAT24, 0, &store_field<&Status::EnergyDeliveredDhw>}};
+
+    inline constexpr size_t REGISTER_FIELD_COUNT = sizeof(REGISTER_FIELDS) / sizeof(REGISTER_FIELDS[0]);
+    static_assert(REGISTER_FIELD_COUNT <= 64, "Register field changed mask is a uint64_t");
+
+    inline constexpr uint64_t ALL_REGISTER_FIELDS = ~uint64_t(0);
+
+    // Mask (bit n = REGISTER_FIELDS[n]) of the fields decoded into Member, 0 if it isn't read from a register.
+    template <auto Member>
+    constexpr uint64_t register_field_mask()
+    {
+        uint64_t mask = 0;
+        for (size_t i = 0; i < REGISTER_FIELD_COUNT; ++i)
+        {
+            if (REGISTER_FIELDS[i].Store == &store_field<Member>)
+                mask |= uint64_t(1) << i;
+        }
+
+        return mask;
+    }
+
+    inline constexpr bool has_register_fields(GetType type)
+    {
+        for (const auto& field : REGISTER_FIELDS)
+        {
+            if (field.Type == type)
+                return true;
+        }
+
+        return false;
+    }
+
+    inline float decode_register_field(const RegisterField& field, Message& res)
+    {
+        if (field.Sentinel != 0 && res.get_u16(field.Offset) == field.Sentinel)
+            return 0.0f;
+
+        switch (field.Encoding)
+        {
+        case FieldEncoding::FLOAT8:
+            return res.get_float8(field.Offset);
+        case FieldEncoding::FLOAT8_V2:
+            return res.get_float8_v2(field.Offset);
+        case FieldEncoding::FLOAT8_V3:
+            return res.get_float8_v3(field.Offset);
+        case FieldEncoding::FLOAT16:
+            return res.get_float16(field.Offset);
+        case FieldEncoding::FLOAT24:
+            return res.get_float24(field.Offset);
+        case FieldEncoding::U8:
+        default:
+            return res[field.Offset];
+        }
+    }
+
+    // Decodes every field carried by a GET_RES into status, returning a mask (bit n = REGISTER_FIELDS[n])
+    // of the fields whose value changed.
+    inline uint64_t decode_registers(Message& res, Status& status)
+    {
+        GetType type = res.payload_type<GetType>();
+        uint64_t changed = 0;
+
+        for (size_t i = 0; i < REGISTER_FIELD_COUNT; ++i)
+        {
+            const RegisterField& field = REGISTER_FIELDS[i];
+            if (field.Type != type)
+                continue;
+
+            if (field.Store(status, decode_register_field(field, res)))
+                changed |= uint64_t(1) << i;
+        }
+
+        return changed;
+    }
+} // namespace ehal::hp
@@ -0,0 +1,220 @@
+#pragma once
+
+#include "ehal_proto.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <vector>
+
+namespace ehal::hp
+{
+    struct QueuedCommand
+    {
+        QueuedCommand(Message&& msg, std::chrono::steady_clock::time_point requestedAt, bool readback = false)
+            : Msg(std::move(msg)), QueuedAt(std::chrono::steady_clock::now()), RequestedAt(requestedAt), Readback(readback)
+        {
+        }
+
+        Message Msg;
+        std::chrono::steady_clock::time_point QueuedAt;
+        std::chrono::steady_clock::time_point RequestedAt; // When the setting this (or its read-back) carries was requested.
+        bool Readback; // The last GET_CMD confirming a setting, which records its latency; see readback_cmds().
+    };
+
+    // Each setting HomeAssistant can change, so that a burst of changes to one of them can be coalesced.
+    // Both zones' room temperatures are one setting, as a zone 2 change is sent for both zones.
+    enum class Setting : uint8_t
+    {
+        ZONE_TEMPERATURE,
+        Z1_FLOW_TEMPERATURE,
+        Z2_FLOW_TEMPERATURE,
+        DHW_TEMPERATURE,
+        DHW_MODE,
+        DHW_FORCE,
+        POWER_MODE,
+        HP_MODE
+    };
+
+    // A setting held for the coalescing window ("Setting Coalescing Window") before it is queued, a later
+    // change to the same setting replaces the held SET_CMD. Held settings are kept in the order they were
+    // first changed, which is the order they are released in.
+    struct PendingSetting
+    {
+        Setting Key;
+        Message Msg;
+        std::chrono::steady_clock::time_point RequestedAt; // First change in the window
+        std::chrono::steady_clock::time_point Due;
+    };
+
+    enum class HoldResult : uint8_t
+    {
+        HELD,     // Held until the window closes
+        REPLACED, // Replaced the change already held, keeping its place, request time and due time
+        NOT_HELD  // No window, cmd is left for the caller to queue
+    };
+
+    inline std::vector<PendingSetting>::iterator find_pending_setting(std::vector<PendingSetting>& pending, Setting setting)
+    {
+        return std::find_if(std::begin(pending), std::end(pending), [&](const PendingSetting& held)
+        {
+            return held.Key == setting;
+        });
+    }
+
+    inline HoldResult hold_pending_setting(std::vector<PendingSetting>& pending, Setting setting, Message& cmd,
+                                           std::chrono::steady_clock::time_point now, uint16_t windowMs)
+    {
+        auto it = find_pending_setting(pending, setting);
+        if (it != std::end(pending))
+        {
+            it->Msg = std::move(cmd);
+            return HoldResult::REPLACED;
+        }
+
+        if (windowMs == 0)
+            return HoldResult::NOT_HELD;
+
+        pending.push_back(PendingSetting{setting, std::move(cmd), now, now + std::chrono::milliseconds(windowMs)});
+        return HoldResult::HELD;
+    }
+
+    // Removes the settings whose coalescing window has closed, in the order they were changed.
+    inline std::vector<QueuedCommand> take_due_settings(std::vector<PendingSetting>& pending, std::chrono::steady_clock::time_point now)
+    {
+        std::vector<QueuedCommand> due;
+        for (auto it = std::begin(pending); it != std::end(pending);)
+        {
+            if (it->Due > now)
+            {
+                ++it;
+                continue;
+            }
+
+            due.emplace_back(std::move(it->Msg), it->RequestedAt);
+            it = pending.erase(it);
+        }
+
+        return due;
+    }
+
+    // The BASIC_SETTINGS payload bytes each SET_SETTINGS_FLAG_* carries (bit n = payload byte n), so that
+    // frames setting different flags can be merged into one.
+    struct BasicSettingsField
+    {
+        uint8_t Flag;
+        uint16_t Bytes;
+    };
+
+    inline constexpr BasicSettingsField BASIC_SETTINGS_FIELDS[] = {
+        {SET_SETTINGS_FLAG_ZONE_TEMPERATURE, 1 << 2 | 1 << 6 | 0xF << 10}, // Zone, control mode, zone 1 & 2 temperatures
+        {SET_SETTINGS_FLAG_DHW_TEMPERATURE, 0x3 << 8},
+        {SET_SETTINGS_FLAG_HP_MODE, 1 << 6},
+        {SET_SETTINGS_FLAG_DHW_MODE, 1 << 5},
+        {SET_SETTINGS_FLAG_MODE_TOGGLE, 1 << 3}};
+
+    inline uint16_t basic_settings_bytes(uint8_t flags)
+    {
+        uint16_t bytes = 0;
+        for (const auto& field : BASIC_SETTINGS_FIELDS)
+        {
+            if (flags & field.Flag)
+                bytes |= field.Bytes;
+        }
+
+        return bytes;
+    }
+
+    // Merges one BASIC_SETTINGS frame into another, if they set different flags and agree on any payload
+    // byte both of them carry (the zone temperature's control mode and the HP mode share byte 6).
+    inline bool merge_basic_settings(Message& into, Message& cmd)
+    {
+        if (into.payload_type<SetType>() != SetType::BASIC_SETTINGS || cmd.payload_type<SetType>() != SetType::BASIC_SETTINGS)
+            return false;
+
+        if (into[1] & cmd[1])
+            return false;
+
+        uint16_t intoBytes = basic_settings_bytes(into[1]);
+        uint16_t cmdBytes = basic_settings_bytes(cmd[1]);
+        for (size_t i = 0; i < PAYLOAD_SIZE; ++i)
+        {
+            if ((intoBytes & cmdBytes & (1 << i)) && into[i] != cmd[i])
+                return false;
+        }
+
+        for (size_t i = 0; i < PAYLOAD_SIZE; ++i)
+        {
+            if (cmdBytes & (1 << i))
+                into[i] = cmd[i];
+        }
+
+        into[1] |= cmd[1];
+        return true;
+    }
+
+    // Merges settings changed together into as few frames as possible, keeping the order of the first change
+    // in each frame; a merged frame is as old as the earliest request it carries. Returns the frames saved.
+    inline size_t merge_settings(std::vector<QueuedCommand>& cmds)
+    {
+        std::vector<QueuedCommand> frames;
+        for (auto& cmd : cmds)
+        {
+            bool merged = false;
+            for (auto& frame : frames)
+            {
+                if (merge_basic_settings(frame.Msg, cmd.Msg))
+                {
+                    frame.RequestedAt = std::min(frame.RequestedAt, cmd.RequestedAt);
+                    merged = true;
+                    break;
+                }
+            }
+
+            if (!merged)
+                frames.push_back(std::move(cmd));
+        }
+
+        size_t saved = cmds.size() - frames.size();
+        cmds = std::move(frames);
+        return saved;
+    }
+
+    // The registers the heat pump reports each setting in, read back as soon as a SET_CMD is acknowledged
+    // so that the confirmed value is published without waiting for the next poll.
+    struct SettingReadback
+    {
+        SetType Type;
+        uint8_t Flags;
+        GetType Register;
+    };
+
+    inline constexpr SettingReadback SETTING_READBACKS[] = {
+        {SetType::BASIC_SETTINGS, SET_SETTINGS_FLAG_ZONE_TEMPERATURE, GetType::TEMPERATURE_CONFIG},
+        {SetType::BASIC_SETTINGS, SET_SETTINGS_FLAG_DHW_TEMPERATURE | SET_SETTINGS_FLAG_HP_MODE | SET_SETTINGS_FLAG_DHW_MODE | SET_SETTINGS_FLAG_MODE_TOGGLE, GetType::MODE_FLAGS_A},
+        {SetType::DHW_SETTING, SET_SETTINGS_FLAG_MODE_TOGGLE, GetType::FORCED_DHW_STATE},
+        {SetType::DHW_SETTING, SET_SETTINGS_FLAG_MODE_TOGGLE, GetType::MODE_FLAGS_A}};
+
+    // A GET_CMD for each register an acknowledged setting is reported in, each register once. The setting
+    // counts as confirmed once the last of them is answered, so only that one is marked Readback.
+    inline std::vector<QueuedCommand> readback_cmds(Message& cmd, std::chrono::steady_clock::time_point requestedAt)
+    {
+        SetType type = cmd.payload_type<SetType>();
+        std::vector<GetType> registers;
+
+        for (const auto& readback : SETTING_READBACKS)
+        {
+            if (readback.Type != type || (readback.Flags & cmd[1]) == 0)
+                continue;
+
+            if (std::find(std::begin(registers), std::end(registers), readback.Register) == std::end(registers))
+                registers.push_back(readback.Register);
+        }
+
+        std::vector<QueuedCommand> cmds;
+        for (size_t i = 0; i < registers.size(); ++i)
+            cmds.emplace_back(Message{MsgType::GET_CMD, registers[i]}, requestedAt, /* readback =*/i + 1 == registers.size());
+
+        return cmds;
+    }
+} // namespace ehal::hp
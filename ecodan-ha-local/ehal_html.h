@@ -66,9 +66,13 @@ namespace ehal
         <input class="column column-75" type="text" inputmode="numeric" id="status_led" name="status_led" value="{{status_led}}" />
     </div>
     <div class="row">
-        <label class="column column-25" for="dump_pkt">Dump Serial Packets:</label>
+        <label class="column column-25" for="dump_pkt">Capture Serial Packets:</label>
         <input class="column column-75" type="checkbox" id="dump_pkt" name="dump_pkt" {{dump_pkt}} />
     </div>
+    <div class="row">
+        <label class="column column-25" for="uart_evt_rx">UART Event Receive:</label>
+        <input class="column column-75" type="checkbox" id="uart_evt_rx" name="uart_evt_rx" {{uart_evt_rx}} />
+    </div>
     <div class="row">
         <label class="column column-25" for="wifi_reset">Auto-Reset WiFi Settings:</label>
         <input class="column column-75" type="checkbox" id="wifi_reset" name="wifi_reset" {{wifi_reset}} />
@@ -79,6 +83,14 @@ namespace ehal
         <label class="column column-25" for="cool_enabled">Cool mode:</label>
         <input class="column column-75" type="checkbox" id="cool_enabled" name="cool_enabled" {{cool_enabled}} />
     </div>
+    <div class="row">
+        <label class="column column-25" for="poll_intervals">Poll Intervals:</label>
+        <input class="column column-75" type="text" id="poll_intervals" name="poll_intervals" value="{{poll_intervals}}" placeholder="02=10,04=10,a1=600" />
+    </div>
+    <div class="row">
+        <label class="column column-25" for="set_coalesce">Setting Coalescing Window (ms):</label>
+        <input class="column column-75" type="number" min="0" max="5000" id="set_coalesce" name="set_coalesce" value="{{set_coalesce}}" />
+    </div>
     <br />
     <h2>Device Unique id</h2>
     <div class="row">
@@ -136,6 +148,34 @@ namespace ehal
         <label class="column column-25" for="mqtt_topic">MQTT Topic:</label>
         <input class="column column-75" type="text" id="mqtt_topic" name="mqtt_topic" value="{{mqtt_topic}}" required />
     </div>
+    <div class="row">
+        <label class="column column-25" for="mqtt_temp_db">MQTT Temperature Deadband (&#176;C):</label>
+        <input class="column column-75" type="number" min="0" max="5" step="0.01" id="mqtt_temp_db" name="mqtt_temp_db" value="{{mqtt_temp_db}}" />
+    </div>
+    <div class="row">
+        <label class="column column-25" for="mqtt_refresh">MQTT Refresh Interval (s):</label>
+        <input class="column column-75" type="number" min="10" max="150" id="mqtt_refresh" name="mqtt_refresh" value="{{mqtt_refresh}}" />
+    </div>
+    <div class="row">
+        <label class="column column-25" for="mqtt_agg_state">MQTT Single State Topic:</label>
+        <input class="column column-75" type="checkbox" id="mqtt_agg_state" name="mqtt_agg_state" {{mqtt_agg_state}} />
+    </div>
+    <div class="row">
+        <label class="column column-25" for="mqtt_state_qos">MQTT State QoS:</label>
+        <input class="column column-75" type="number" min="0" max="2" id="mqtt_state_qos" name="mqtt_state_qos" value="{{mqtt_state_qos}}" />
+    </div>
+    <div class="row">
+        <label class="column column-25" for="mqtt_disc_qos">MQTT Discovery QoS:</label>
+        <input class="column column-75" type="number" min="0" max="2" id="mqtt_disc_qos" name="mqtt_disc_qos" value="{{mqtt_disc_qos}}" />
+    </div>
+    <div class="row">
+        <label class="column column-25" for="mqtt_cmd_qos">MQTT Command QoS:</label>
+        <input class="column column-75" type="number" min="0" max="2" id="mqtt_cmd_qos" name="mqtt_cmd_qos" value="{{mqtt_cmd_qos}}" />
+    </div>
+    <div class="row">
+        <label class="column column-25" for="mqtt_core">MQTT Task Core:</label>
+        <input class="column column-75" type="number" min="0" max="1" id="mqtt_core" name="mqtt_core" value="{{mqtt_core}}" />
+    </div>
     <br />
     <div class="row">
         <input class="column column-25" id="reset" type="button" value="Restore Defaults" onclick='clear_config()' />
@@ -250,6 +290,96 @@ namespace ehal
         <td>Heat Pump Message Rx Count:</td>
         <td>{{hp_rx_count}}</td>
     </tr>
+    <tr>
+        <td>Heat Pump Rx Bytes Dropped:</td>
+        <td>{{hp_rx_dropped}}</td>
+    </tr>
+    <tr>
+        <td>Heat Pump Rx Wakeups / Message:</td>
+        <td>{{hp_rx_wakeups}}</td>
+    </tr>
+    <tr>
+        <td>Heat Pump Rx CPU Time / Message:</td>
+        <td>{{hp_rx_cpu_us}} &micro;s</td>
+    </tr>
+    <tr>
+        <td>Heat Pump Tx Blocking Time / Message:</td>
+        <td>{{hp_tx_us}} &micro;s</td>
+    </tr>
+    <tr>
+        <td>Heat Pump Tx Buffer Full Count:</td>
+        <td>{{hp_tx_ring_full}}</td>
+    </tr>
+    <tr>
+        <td>Heat Pump Queue Depth (Set / Get):</td>
+        <td>{{hp_queue_depth}}</td>
+    </tr>
+    <tr>
+        <td>Heat Pump Settings Pending / Coalesced / Merged:</td>
+        <td>{{hp_set_coalesced}}</td>
+    </tr>
+    <tr>
+        <td>Heat Pump Setting Confirmation Latency (&lt;250 / &lt;500 / &lt;1000 / &lt;2000 / &lt;5000 / &ge;5000 ms):</td>
+        <td>{{hp_confirm_latency}}</td>
+    </tr>
+    <tr>
+        <td>Heat Pump Set Command Queue Wait (Avg / Max):</td>
+        <td>{{hp_set_wait}}</td>
+    </tr>
+    <tr>
+        <td>Heat Pump Get Command Queue Wait (Avg / Max):</td>
+        <td>{{hp_get_wait}}</td>
+    </tr>
+    <tr>
+        <td>Heat Pump Serial Bus Utilization:</td>
+        <td>{{hp_bus_util}}%</td>
+    </tr>
+    <tr>
+        <td>Heat Pump Packet Capture:</td>
+        <td>{{hp_capture_frames}} (<a href="/capture.pcap">download</a>)</td>
+    </tr>
+    <tr>
+        <td>MQTT Connection Attempts (Failed / Disconnects):</td>
+        <td>{{mqtt_conn_attempts}}</td>
+    </tr>
+    <tr>
+        <td>MQTT Connection Attempt Time (Last / Avg / Max):</td>
+        <td>{{mqtt_conn_time}}</td>
+    </tr>
+    <tr>
+        <td>MQTT Next Reconnect:</td>
+        <td>{{mqtt_next_attempt}}</td>
+    </tr>
+    <tr>
+        <td>MQTT Backlog (Overwritten):</td>
+        <td>{{mqtt_backlog}}</td>
+    </tr>
+    <tr>
+        <td>MQTT State Messages Published:</td>
+        <td>{{mqtt_published}}</td>
+    </tr>
+    <tr>
+        <td>MQTT State Messages Suppressed (Unchanged):</td>
+        <td>{{mqtt_suppressed}}</td>
+    </tr>
+    <tr>
+        <td>MQTT Last State Update (Messages / Bytes Copied / Allocations):</td>
+        <td>{{mqtt_state_cycle}}</td>
+    </tr>
+    <tr>
+        <td>MQTT Last Discovery (Messages / Bytes Copied / Allocations):</td>
+        <td>{{mqtt_disc_cycle}}</td>
+    </tr>
+</table>
+<table>
+    <thead>
+        <th>Heat Pump Command</th>
+        <th>Responses</th>
+        <th>Retransmits</th>
+        <th>Failures</th>
+        <th>Avg / Max Round Trip</th>
+    <thead>
+    {{hp_cmd_stats}}
 </table>
 <h2>Logs</h2>
 <pre><code class="column column-33 column-offset-33" style="max-height:250px;overflow:auto;" id="logs">
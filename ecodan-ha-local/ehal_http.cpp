@@ -1,19 +1,18 @@
+#include "ehal_capture.h"
 #include "ehal_config.h"
 #include "ehal_css.h"
 #include "ehal_diagnostics.h"
+#include "ehal_hal.h"
 #include "ehal_hp.h"
 #include "ehal_html.h"
 #include "ehal_http.h"
 #include "ehal_js.h"
 #include "ehal_mqtt.h"
+#include "ehal_mqtt_backlog.h"
 #include "ehal_thirdparty.h"
 #include "ehal.h"
 
-#include <DNSServer.h>
-#include <Update.h>
-#include <WebServer.h>
-#include <WiFi.h>
-
+#include <algorithm>
 #include <chrono>
 #include <thread>
 
@@ -60,7 +59,7 @@ namespace ehal::http
 
     String generate_login_cookie()
     {
-        String payload = config_instance().DevicePassword + String(xTaskGetTickCount());
+        String payload = config_instance().DevicePassword + String(millis());
         uint8_t sha256[32];
 
         mbedtls_md_context_t ctx;
@@ -159,11 +158,16 @@ namespace ehal::http
         page.replace(F("{{serial_tx}}"), String(config.SerialTxPort));
         page.replace(F("{{status_led}}"), String(config.StatusLed));
 
-        if (config.DumpPackets)
+        if (config.CapturePackets)
             page.replace(F("{{dump_pkt}}"), F("checked"));
         else
             page.replace(F("{{dump_pkt}}"), "");
 
+        if (config.UartEventRx)
+            page.replace(F("{{uart_evt_rx}}"), F("checked"));
+        else
+            page.replace(F("{{uart_evt_rx}}"), "");
+
         if (config.WifiReset)
             page.replace(F("{{wifi_reset}}"), F("checked"));
         else
@@ -175,6 +179,9 @@ namespace ehal::http
         else
             page.replace(F("{{cool_enabled}}"), "");
 
+        page.replace(F("{{poll_intervals}}"), config.PollIntervals);
+        page.replace(F("{{set_coalesce}}"), String(config.SetCoalesceMs));
+
         if (config.UniqueId.length() > 0)
             page.replace(F("{{unique_id}}"), config.UniqueId);
         else
@@ -188,6 +195,18 @@ namespace ehal::http
         page.replace(F("{{mqtt_user}}"), config.MqttUserName);
         page.replace(F("{{mqtt_pw}}"), config.MqttPassword);
         page.replace(F("{{mqtt_topic}}"), config.MqttTopic);
+        page.replace(F("{{mqtt_temp_db}}"), String(config.MqttTempDeadband, 2));
+        page.replace(F("{{mqtt_refresh}}"), String(config.MqttRefreshInterval));
+
+        if (config.MqttAggregateState)
+            page.replace(F("{{mqtt_agg_state}}"), F("checked"));
+        else
+            page.replace(F("{{mqtt_agg_state}}"), "");
+
+        page.replace(F("{{mqtt_state_qos}}"), String(config.MqttStateQos));
+        page.replace(F("{{mqtt_disc_qos}}"), String(config.MqttDiscoveryQos));
+        page.replace(F("{{mqtt_cmd_qos}}"), String(config.MqttCommandQos));
+        page.replace(F("{{mqtt_core}}"), String(config.MqttTaskCore));
 
         server.send(200, F("text/html"), page);
     }
@@ -211,15 +230,23 @@ namespace ehal::http
         config.StatusLed = server.arg(F("status_led")).toInt();
 
         if (server.hasArg(F("dump_pkt")))
-            config.DumpPackets = true;
+            config.CapturePackets = true;
+        else
+            config.CapturePackets = false;
+
+        if (server.hasArg(F("uart_evt_rx")))
+            config.UartEventRx = true;
         else
-            config.DumpPackets = false;
+            config.UartEventRx = false;
 
         if (server.hasArg(F("cool_enabled")))
             config.CoolEnabled = true;
         else
             config.CoolEnabled = false;
 
+        config.PollIntervals = server.arg(F("poll_intervals"));
+        config.SetCoalesceMs = std::clamp<long>(server.arg(F("set_coalesce")).toInt(), 0, 5000);
+
         if (server.hasArg(F("wifi_reset")))
             config.WifiReset = true;
         else
@@ -236,6 +263,18 @@ namespace ehal::http
         config.MqttUserName = server.arg(F("mqtt_user"));
         config.MqttPassword = server.arg(F("mqtt_pw"));
         config.MqttTopic = server.arg(F("mqtt_topic"));
+        config.MqttTempDeadband = std::clamp(server.arg(F("mqtt_temp_db")).toFloat(), 0.0f, 5.0f);
+        config.MqttRefreshInterval = std::clamp<long>(server.arg(F("mqtt_refresh")).toInt(), 10, 150);
+
+        if (server.hasArg(F("mqtt_agg_state")))
+            config.MqttAggregateState = true;
+        else
+            config.MqttAggregateState = false;
+
+        config.MqttStateQos = std::clamp<long>(server.arg(F("mqtt_state_qos")).toInt(), 0, 2);
+        config.MqttDiscoveryQos = std::clamp<long>(server.arg(F("mqtt_disc_qos")).toInt(), 0, 2);
+        config.MqttCommandQos = std::clamp<long>(server.arg(F("mqtt_cmd_qos")).toInt(), 0, 2);
+        config.MqttTaskCore = std::clamp<long>(server.arg(F("mqtt_core")).toInt(), 0, 1);
         save_configuration(config);
 
         String page{F(PAGE_TEMPLATE)};
@@ -356,10 +395,81 @@ namespace ehal::http
 
         page.replace(F("{{hp_tx_count}}"), uint64_to_string(hp::get_tx_msg_count()));
         page.replace(F("{{hp_rx_count}}"), uint64_to_string(hp::get_rx_msg_count()));
+        page.replace(F("{{hp_rx_dropped}}"), uint64_to_string(hp::get_rx_dropped_byte_count()));
+        page.replace(F("{{hp_rx_wakeups}}"), String(hp::get_rx_wakeups_per_msg(), 2));
+        page.replace(F("{{hp_rx_cpu_us}}"), String(hp::get_rx_cpu_us_per_msg(), 1));
+        page.replace(F("{{hp_tx_us}}"), String(hp::get_tx_us_per_msg(), 1));
+        page.replace(F("{{hp_tx_ring_full}}"), uint64_to_string(hp::get_tx_ring_full_count()));
+
+        hp::QueueStats queueStats = hp::get_queue_stats();
+        page.replace(F("{{hp_queue_depth}}"), String(queueStats.SetDepth) + F(" / ") + String(queueStats.GetDepth) + F(" (max ") + String(queueStats.MaxSetDepth) + F(" / ") + String(queueStats.MaxGetDepth) + F(")"));
+        page.replace(F("{{hp_set_coalesced}}"), String(queueStats.PendingSettings) + F(" / ") + String(queueStats.CoalescedSets) + F(" / ") + String(queueStats.MergedSets));
+        page.replace(F("{{hp_set_wait}}"), String(queueStats.AverageSetWaitMs) + F(" / ") + String(queueStats.MaxSetWaitMs) + F(" ms"));
+        page.replace(F("{{hp_get_wait}}"), String(queueStats.AverageGetWaitMs) + F(" / ") + String(queueStats.MaxGetWaitMs) + F(" ms"));
+        page.replace(F("{{hp_bus_util}}"), String(hp::get_bus_utilization(), 1));
+        page.replace(F("{{hp_capture_frames}}"), String(capture::frame_count()) + F(" / ") + String(capture::capacity()) + F(" frames, ") + uint64_to_string(capture::overwritten_frame_count()) + F(" overwritten"));
+
+        hp::ConfirmLatencyHistogram confirmLatency = hp::get_confirm_latency_histogram();
+        String confirmCounts;
+        for (size_t i = 0; i < hp::ConfirmLatencyHistogram::BUCKETS; ++i)
+        {
+            if (i > 0)
+                confirmCounts += F(" / ");
+            confirmCounts += String(confirmLatency.Counts[i]);
+        }
+        page.replace(F("{{hp_confirm_latency}}"), confirmCounts);
+
+        mqtt::ConnectionStats connStats = mqtt::get_connection_stats();
+        page.replace(F("{{mqtt_conn_attempts}}"), String(connStats.Attempts) + F(" (") + String(connStats.Failures) + F(" / ") + String(connStats.Disconnects) + F(")"));
+        page.replace(F("{{mqtt_conn_time}}"), String(connStats.LastAttemptMs) + F(" / ") + String(connStats.AverageAttemptMs) + F(" / ") + String(connStats.MaxAttemptMs) + F(" ms"));
+        page.replace(F("{{mqtt_next_attempt}}"), connStats.NextAttemptInMs > 0 ? String(connStats.NextAttemptInMs) + F(" ms") : String(F("-")));
+        page.replace(F("{{mqtt_backlog}}"), String(mqtt::backlog::size()) + F(" / ") + String(mqtt::backlog::capacity()) + F(" (") + uint64_to_string(mqtt::backlog::overwritten_count()) + F(")"));
+        page.replace(F("{{mqtt_published}}"), uint64_to_string(mqtt::get_published_count()));
+        page.replace(F("{{mqtt_suppressed}}"), uint64_to_string(mqtt::get_suppressed_count()));
+
+        auto format_cycle_stats = [](const mqtt::PublishCycleStats& stats)
+        {
+            return String(stats.Messages) + F(" / ") + String(stats.BytesCopied) + F(" / ") + String(stats.Allocations);
+        };
+        page.replace(F("{{mqtt_state_cycle}}"), format_cycle_stats(mqtt::get_state_cycle_stats()));
+        page.replace(F("{{mqtt_disc_cycle}}"), format_cycle_stats(mqtt::get_discovery_cycle_stats()));
+
+        String cmdStats;
+        for (const auto& cmd : hp::get_command_stats())
+        {
+            cmdStats += F("<tr><td>");
+            cmdStats += cmd.Name;
+            cmdStats += F("</td><td>");
+            cmdStats += String(cmd.Count);
+            cmdStats += F("</td><td>");
+            cmdStats += String(cmd.Retransmits);
+            cmdStats += F("</td><td>");
+            cmdStats += String(cmd.Failures);
+            cmdStats += F("</td><td>");
+            cmdStats += String(cmd.AverageRttMs) + F(" / ") + String(cmd.MaxRttMs) + F(" ms");
+            cmdStats += F("</td></tr>");
+        }
+        page.replace(F("{{hp_cmd_stats}}"), cmdStats);
 
         server.send(200, F("text/html"), page);
     }
 
+    void handle_download_capture()
+    {
+        if (show_login_if_required())
+            return;
+
+        server.sendHeader(F("Content-Disposition"), F("attachment; filename=\"ecodan-cn105.pcap\""));
+        server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+        server.send(200, F("application/vnd.tcpdump.pcap"), "");
+
+        capture::write_pcap([](const uint8_t* data, size_t length)
+        {
+            server.sendContent(reinterpret_cast<const char*>(data), length);
+        });
+        server.sendContent("");
+    }
+
     void handle_diagnostic_js()
     {
         String js{F(SCRIPT_UPDATE_DIAGNOSTIC_LOGS)};
@@ -376,8 +486,7 @@ namespace ehal::http
         page.replace(F("{{PAGE_BODY}}"), F(BODY_TEMPLATE_HEAT_PUMP));
 
         {
-            auto& status = hp::get_status();
-            std::lock_guard<hp::Status> lock{status};
+            hp::Status status = hp::get_status();
 
             page.replace(F("{{z1_room_temp}}"), String(status.Zone1RoomTemperature, 1));
             page.replace(F("{{z1_set_temp}}"), String(status.Zone1SetTemperature, 1));
@@ -426,6 +535,52 @@ namespace ehal::http
         server.send(200, F("text/html"), page);
     }
 
+    // Changes several heat pump settings with one request (form fields as for the MQTT settings topic),
+    // e.g. curl -d z1_temp=21.5 -d dhw_temp=48 http://<device>/settings
+    void handle_settings()
+    {
+        if (show_login_if_required())
+            return;
+
+        hp::SettingsChange change;
+        if (server.hasArg(F("z1_temp")))
+            change.Z1Temperature = server.arg(F("z1_temp")).toFloat();
+        if (server.hasArg(F("z1_flow_temp")))
+            change.Z1FlowTemperature = server.arg(F("z1_flow_temp")).toFloat();
+        if (server.hasArg(F("z2_temp")))
+            change.Z2Temperature = server.arg(F("z2_temp")).toFloat();
+        if (server.hasArg(F("z2_flow_temp")))
+            change.Z2FlowTemperature = server.arg(F("z2_flow_temp")).toFloat();
+        if (server.hasArg(F("dhw_temp")))
+            change.DhwTemperature = server.arg(F("dhw_temp")).toFloat();
+        if (server.hasArg(F("dhw_mode")))
+            change.DhwMode = server.arg(F("dhw_mode"));
+        if (server.hasArg(F("dhw_force")))
+            change.DhwForce = server.arg(F("dhw_force")) == F("true");
+        if (server.hasArg(F("power")))
+            change.Power = server.arg(F("power")) == F("true");
+
+        if (server.hasArg(F("hp_mode")))
+        {
+            uint8_t mode;
+            if (!hp::hp_mode_from_string(server.arg(F("hp_mode")), mode))
+            {
+                server.send(400, F("text/plain"), F("Unknown hp_mode"));
+                return;
+            }
+
+            change.HpMode = mode;
+        }
+
+        if (!hp::set_settings(change))
+        {
+            server.send(400, F("text/plain"), F("Settings rejected, see the diagnostic log"));
+            return;
+        }
+
+        server.send(200, F("text/plain"), F("OK"));
+    }
+
     void handle_firmware_update()
     {
         String page{F(PAGE_TEMPLATE)};
@@ -540,6 +695,7 @@ namespace ehal::http
         server.on(F("/verify_login"), handle_verify_login);
         server.on(F("/save"), handle_save_configuration);
         server.on(F("/clear_config"), handle_clear_config);
+        server.on(F("/settings"), HTTP_POST, handle_settings);
         server.on(F("/update"), HTTP_POST, handle_firmware_update, handle_firmware_update_handler);
 
         // XMLHTTPRequest / Javascript / CSS
@@ -549,6 +705,7 @@ namespace ehal::http
         server.on(F("/configuration.js"), handle_configuration_js);
         server.on(F("/reboot.js"), handle_reboot_js);
         server.on(F("/diagnostic.js"), handle_diagnostic_js);
+        server.on(F("/capture.pcap"), handle_download_capture);
         server.on(F("/redirect.js"), handle_redirect_js);
         server.on(F("/milligram.css"), handle_milligram_css);
 
@@ -1,49 +1,178 @@
 #include "ehal.h"
 #include "ehal_config.h"
 #include "ehal_diagnostics.h"
+#include "ehal_hal.h"
 #include "ehal_hp.h"
 #include "ehal_mqtt.h"
+#include "ehal_mqtt_backlog.h"
+#include "ehal_mqtt_entities.h"
 #include "ehal_thirdparty.h"
 
-#include <WiFi.h>
-#include <WiFiClient.h>
-
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 namespace ehal::mqtt
 {
-#define SENSOR_STATE_TIMEOUT (300) // If we update HP state once a minute, expiring HA states after 300s seems appropriate.
+#define SENSOR_STATE_TIMEOUT (300) // Unchanged states are re-published every MQTT refresh interval (at most half this), so HA only expires them if updates stop.
+#define CONNECT_BACKOFF_MIN_MS (1000)
+#define CONNECT_BACKOFF_MAX_MS (300000)
+#define CONNECT_TCP_TIMEOUT_MS (2000) // An unreachable broker costs the MQTT task at most this per attempt.
+#define BACKLOG_DRAIN_BATCH (10) // Samples published per drain interval after reconnecting.
+#define BACKLOG_DRAIN_INTERVAL_MS (1000)
+#define MQTT_BUFFER_SIZE (4096)
+#define MQTT_TASK_STACK_SIZE (8192)
+#define MQTT_TASK_IDLE_MS (50) // Longest the MQTT task sleeps between servicing the client.
+#define BACKLOG_SAMPLE_INTERVAL_MS (30000) // Poll cycles held while the broker is unreachable are thinned to one per interval.
+
+    bool publish_entity_state_updates(uint64_t changedFields);
+    void publish_homeassistant_auto_discover();
+
+    std::thread mqttThread;
+    bool needsAutoDiscover = true;
+
+    // The connection is (re-)established a step at a time from handle_loop(), so that a missing
+    // broker never stalls the MQTT task for longer than CONNECT_TCP_TIMEOUT_MS. Only the MQTT handshake
+    // with a broker which accepted the TCP connection can take up to the client's command timeout.
+    enum class ConnectionState
+    {
+        DISCONNECTED, // Waiting for the next connection attempt
+        HANDSHAKE,    // TCP connected, sending CONNECT and waiting for CONNACK
+        SUBSCRIBING,  // Connected, subscribing to one command topic per loop
+        CONNECTED
+    };
 
-    bool publish_climate_status();
-    bool publish_z2_climate_status();
-    bool publish_binary_sensor_status(const String& name, bool on);
-    template <typename T>
-    bool publish_sensor_status(const String& name, T value);
-    bool connect_mqtt();
+    std::atomic<ConnectionState> connectionState{ConnectionState::DISCONNECTED};
+    std::chrono::steady_clock::time_point nextConnectAttempt;
+    uint32_t connectBackoffMs = 0;
+    size_t nextSubscription = 0;
+    std::mutex connectionStatsMutex; // Guards connectionStats and nextConnectAttempt, read by the web server.
+    ConnectionStats connectionStats = {};
+    uint64_t totalConnectAttemptMs = 0;
+    uint32_t tcpConnectMs = 0; // Time the current attempt spent on its TCP connect.
+
+    // Last state published to each state topic, so unchanged states can be skipped.
+    struct PublishedState
+    {
+        uint32_t PayloadHash; // FNV-1a, so the payload doesn't need to be copied to compare against it.
+        float Value;
+        std::chrono::steady_clock::time_point PublishedAt;
+    };
 
-    std::mutex statusUpdateMtx;
-    bool needsAutoDiscover = true;
+    std::map<String, PublishedState> publishedStates;
+    std::chrono::steady_clock::time_point lastFullStatePass; // Last poll cycle which published every scalar entity
+    uint32_t statusDeltaOverflowsSeen = 0;
+    std::map<String, uint32_t> publishedDiscoveryHashes; // Discovery topic -> FNV-1a hash of its payload
+    std::atomic<uint64_t> publishedCount{0};
+    std::atomic<uint64_t> suppressedCount{0};
+
+    // While publish_entity_state_updates() runs in single state topic mode, entity states are collected
+    // into this document instead of being published individually.
+    JsonDocument* aggregateState = nullptr;
+    bool aggregateDeadband = true; // Cleared for backlog samples, which must not move the live baselines.
+    std::vector<float> aggregatedValues; // Last value of each deadbanded field in the document, by entity.
+
+    // Strings derived from configuration for each of ENTITIES, built once (before the first connection).
+    struct EntityTopics
+    {
+        String StateTopic; // The entity's own state topic, regardless of the single state topic setting
+        String CommandTopic;
+        String Field; // Key of the entity's value in the single state topic document
+    };
+
+    std::vector<EntityTopics> entityTopics;
+    String aggregateStateTopic;
+    String historyTopic;
     WiFiClient espClient;
-    MQTTClient mqttClient(4096);
-
-    enum class SensorType
-    {
-        POWER,
-        LIVE_POWER,
-        FREQUENCY,
-        TEMPERATURE,
-        FLOW_RATE,
-        COP,
-        CONNECTIVITY,
-        WIFI_SIGNAL,
-        WIFI_SSID,
-        IP_ADDRESS,
-        MAC_ADDRESS
+    MQTTClient mqttClient(MQTT_BUFFER_SIZE);
+
+    // Payloads are serialized straight into this buffer and handed to the client from there, rather than
+    // going through a String. Only used from the MQTT task.
+    char payloadBuffer[MQTT_BUFFER_SIZE];
+
+    // Counts the heap allocations made by the JSON documents payloads are built in.
+    class PayloadAllocator : public ArduinoJson::Allocator
+    {
+    public:
+        void* allocate(size_t size) override
+        {
+            ++Allocations;
+            return malloc(size);
+        }
+
+        void deallocate(void* ptr) override
+        {
+            free(ptr);
+        }
+
+        void* reallocate(void* ptr, size_t newSize) override
+        {
+            ++Allocations;
+            return realloc(ptr, newSize);
+        }
+
+        uint32_t Allocations = 0;
+    } payloadAllocator;
+
+    PublishCycleStats currentCycle = {};
+    PublishCycleStats stateCycleStats = {};
+    PublishCycleStats discoveryCycleStats = {};
+    std::mutex publishCycleStatsMutex; // Guards stateCycleStats and discoveryCycleStats, read by the web server.
+
+    // Measures the messages, bytes and allocations it takes to publish one batch of messages (a state
+    // update or a discovery pass), recording them into result when it goes out of scope.
+    class PublishCycle
+    {
+    public:
+        explicit PublishCycle(PublishCycleStats& result)
+            : result_(result)
+        {
+            currentCycle = {};
+            payloadAllocator.Allocations = 0;
+        }
+
+        ~PublishCycle()
+        {
+            currentCycle.Allocations = payloadAllocator.Allocations;
+
+            std::lock_guard<std::mutex> lock{publishCycleStatsMutex};
+            result_ = currentCycle;
+        }
+
+    private:
+        PublishCycleStats& result_;
+    };
+
+    // Each class of message is published/subscribed with its own configured QoS.
+    enum class MessageClass
+    {
+        STATE,     // Entity states, superseded by the next update so losing one is harmless
+        DISCOVERY, // HomeAssistant discovery config
+        COMMAND    // Commands from HomeAssistant
     };
 
+    int message_qos(MessageClass messageClass)
+    {
+        const auto& config = config_instance();
+        switch (messageClass)
+        {
+        case MessageClass::DISCOVERY:
+            return std::min<int>(config.MqttDiscoveryQos, LWMQTT_QOS2);
+        case MessageClass::COMMAND:
+            return std::min<int>(config.MqttCommandQos, LWMQTT_QOS2);
+        case MessageClass::STATE:
+        default:
+            return std::min<int>(config.MqttStateQos, LWMQTT_QOS2);
+        }
+    }
+
     // https://arduinojson.org/v6/how-to/configure-the-serialization-of-floats/#how-to-reduce-the-number-of-decimal-places
     double round2(double value)
     {
@@ -93,9 +222,6 @@ off
 21
 {% endif %})"));
 
-        auto& status = hp::get_status();
-        std::lock_guard<hp::Status> lock{status};
-
         tpl.replace("\n", "");
         tpl.replace(F("{{min_temp}}"), String(hp::get_min_thermostat_temperature()));
         tpl.replace(F("{{max_temp}}"), String(hp::get_max_thermostat_temperature()));
@@ -132,18 +258,6 @@ off
         {
             log_web(F("Failed to set z1 target temperature!"));
         }
-        else
-        {
-            {
-                auto& status = hp::get_status();
-                std::lock_guard<hp::Status> lock{status};
-                status.Zone1SetTemperature = setTemperature;
-            }
-
-            // Ensure lock is released, because publish_climate_status will attempt
-            // to acquire it internally
-            publish_climate_status();
-        }
     }
 
     void on_z1_flow_target_temperature_set_command(const String& payload)
@@ -159,14 +273,6 @@ off
         {
             log_web(F("Failed to set Z1 flow target temperature!"));
         }
-        else
-        {
-            auto& status = hp::get_status();
-            std::lock_guard<hp::Status> lock{status};
-            status.Zone1FlowTemperatureSetPoint = setTemperature;
-
-            publish_sensor_status<float>(F("z1_flow_temp_target"), setTemperature);
-        }
     }
 
     void on_z2_temperature_set_command(const String& payload)
@@ -182,18 +288,6 @@ off
         {
             log_web(F("Failed to set z2 target temperature!"));
         }
-        else
-        {
-            {
-                auto& status = hp::get_status();
-                std::lock_guard<hp::Status> lock{status};
-                status.Zone2SetTemperature = setTemperature;
-            }
-
-            // Ensure lock is released, because publish_z2_climate_status will attempt
-            // to acquire it internally
-            publish_z2_climate_status();
-        }
     }
 
     void on_z2_flow_target_temperature_set_command(const String& payload)
@@ -209,14 +303,6 @@ off
         {
             log_web(F("Failed to set Z2 flow target temperature!"));
         }
-        else
-        {
-            auto& status = hp::get_status();
-            std::lock_guard<hp::Status> lock{status};
-            status.Zone2FlowTemperatureSetPoint = setTemperature;
-
-            publish_sensor_status<float>(F("z2_flow_temp_target"), setTemperature);
-        }
     }
 
     void on_dhw_temperature_set_command(const String& payload)
@@ -232,41 +318,12 @@ off
         {
             log_web(F("Failed to set DHW target temperature!"));
         }
-        else
-        {
-            auto& status = hp::get_status();
-            std::lock_guard<hp::Status> lock{status};
-            status.Zone1SetTemperature = setTemperature;
-
-            publish_sensor_status<float>(F("dhw_flow_temp_target"), setTemperature);
-        }
     }
 
     void on_mode_set_command(const String& payload)
     {
-        uint8_t mode = -1;
-
-        if (payload == "Heat Target Temperature")
-        {
-            mode = static_cast<uint8_t>(hp::Status::HpMode::HEAT_ROOM_TEMP);
-        }
-        else if (payload == "Heat Flow Temperature")
-        {
-            mode = static_cast<uint8_t>(hp::Status::HpMode::HEAT_FLOW_TEMP);
-        }
-        else if (payload == "Heat Compensation Curve")
-        {
-            mode = static_cast<uint8_t>(hp::Status::HpMode::HEAT_COMPENSATION_CURVE);
-        }
-        else if (payload == "Cool Target Temperature")
-        {
-            mode = static_cast<uint8_t>(hp::Status::HpMode::COOL_ROOM_TEMP);
-        }
-        else if (payload == "Cool Flow Temperature")
-        {
-            mode = static_cast<uint8_t>(hp::Status::HpMode::COOL_FLOW_TEMP);
-        }
-        else
+        uint8_t mode;
+        if (!hp::hp_mode_from_string(payload, mode))
         {
             log_web(F("Unexpected mode requested: %s"), payload.c_str());
             return;
@@ -276,14 +333,6 @@ off
         {
             log_web(F("Failed to set hp heating coling operation mode!"));
         }
-        else
-        {
-            auto& status = hp::get_status();
-            std::lock_guard<hp::Status> lock{status};
-            status.set_heating_cooling_mode(mode);
-
-            publish_sensor_status<String>(F("mode_heating_cooling"), status.hp_mode_as_string());
-        }
     }
 
     void on_dhw_mode_set_command(const String& payload)
@@ -292,19 +341,6 @@ off
         {
             log_web(F("Failed to set DHW mode!"));
         }
-        else
-        {
-            auto& status = hp::get_status();
-            std::lock_guard<hp::Status> lock{status};
-            if (payload == "eco")
-                status.HotWaterMode = hp::Status::DhwMode::ECO;
-            else if (payload == "performance")
-                status.HotWaterMode = hp::Status::DhwMode::NORMAL;
-            else if (payload == "off")
-                status.Operation = hp::Status::OperationMode::OFF;
-
-            publish_sensor_status<String>(F("mode_dhw"), status.dhw_mode_as_string());
-        }
     }
 
     void on_force_dhw_command(const String& payload)
@@ -315,13 +351,6 @@ off
         {
             log_web(F("Failed to force DHW: %s"), payload.c_str());
         }
-        else
-        {
-            auto& status = hp::get_status();
-            std::lock_guard<hp::Status> lock{status};
-            status.DhwForcedActive = forced;
-            publish_binary_sensor_status(F("mode_dhw_forced"), forced);
-        }
     }
 
     void on_turn_on_off_command(const String& payload)
@@ -332,76 +361,156 @@ off
         {
             log_web(F("Failed to set power mode!"));
         }
-        else
+    }
+
+    // Several settings at once as a JSON object, e.g. {"z1_temp": 21.5, "dhw_temp": 48, "dhw_mode": "eco"},
+    // sent to the heat pump as a single BASIC_SETTINGS frame where possible.
+    void on_settings_command(const String& payload)
+    {
+        JsonDocument doc; // Not payloadAllocator, which only counts allocations made by publishing.
+        DeserializationError error = deserializeJson(doc, payload);
+        if (error)
+        {
+            log_web(F("Invalid settings command: %s"), error.c_str());
+            return;
+        }
+
+        hp::SettingsChange change;
+        if (doc[F("z1_temp")].is<float>())
+            change.Z1Temperature = doc[F("z1_temp")].as<float>();
+        if (doc[F("z1_flow_temp")].is<float>())
+            change.Z1FlowTemperature = doc[F("z1_flow_temp")].as<float>();
+        if (doc[F("z2_temp")].is<float>())
+            change.Z2Temperature = doc[F("z2_temp")].as<float>();
+        if (doc[F("z2_flow_temp")].is<float>())
+            change.Z2FlowTemperature = doc[F("z2_flow_temp")].as<float>();
+        if (doc[F("dhw_temp")].is<float>())
+            change.DhwTemperature = doc[F("dhw_temp")].as<float>();
+        if (doc[F("dhw_mode")].is<const char*>())
+            change.DhwMode = String(doc[F("dhw_mode")].as<const char*>());
+        if (doc[F("dhw_force")].is<bool>())
+            change.DhwForce = doc[F("dhw_force")].as<bool>();
+        if (doc[F("power")].is<bool>())
+            change.Power = doc[F("power")].as<bool>();
+
+        if (doc[F("hp_mode")].is<const char*>())
         {
-            auto& status = hp::get_status();
-            std::lock_guard<hp::Status> lock{status};
-            if (turnON)
+            uint8_t mode;
+            if (!hp::hp_mode_from_string(doc[F("hp_mode")].as<const char*>(), mode))
             {
-                status.Power = hp::Status::PowerMode::ON;
+                log_web(F("Unexpected mode requested: %s"), doc[F("hp_mode")].as<const char*>());
+                return;
             }
-            else
+
+            change.HpMode = mode;
+        }
+
+        if (!hp::set_settings(change))
+        {
+            log_web(F("Failed to apply settings command!"));
+        }
+    }
+
+    // HomeAssistant publishes "online" to its status topic when it starts, and has forgotten any
+    // state (and non-retained discovery) sent before then.
+    void on_homeassistant_status(const String& payload)
+    {
+        if (payload != F("online"))
+            return;
+
+        log_web(F("HomeAssistant came online, re-publishing discovery and state"));
+        publishedDiscoveryHashes.clear();
+        publishedStates.clear();
+        needsAutoDiscover = true;
+    }
+
+    // Command topic -> handler, sorted by FNV-1a hash of the topic so an incoming message can be
+    // dispatched with a binary search and no allocation.
+    struct CommandTopic
+    {
+        uint32_t Hash;
+        String Topic;
+        void (*Handler)(const String& payload);
+    };
+
+    std::vector<CommandTopic> commandTopics;
+
+    // https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function
+    uint32_t fnv1a_hash(const char* str)
+    {
+        uint32_t hash = 2166136261U;
+        while (*str)
+        {
+            hash ^= static_cast<uint8_t>(*str++);
+            hash *= 16777619U;
+        }
+
+        return hash;
+    }
+
+    void add_command_topic(const String& topic, void (*handler)(const String& payload))
+    {
+        commandTopics.push_back(CommandTopic{fnv1a_hash(topic.c_str()), topic, handler});
+    }
+
+    // Topics only depend on configuration, so they are built once (before the first connection).
+    void build_topic_registry()
+    {
+        const auto& config = config_instance();
+
+        entityTopics.clear();
+        commandTopics.clear();
+        for (const auto& entity : ENTITIES)
+        {
+            String uniqueName = unique_entity_name(entity.Name);
+
+            EntityTopics topics;
+            topics.StateTopic = config.MqttTopic + "/" + uniqueName + F("/state");
+            topics.Field = entity.Name;
+            topics.Field.replace(" ", "_");
+
+            if (entity.OnCommand != nullptr)
             {
-                status.Power = hp::Status::PowerMode::STANDBY;
+                topics.CommandTopic = config.MqttTopic + "/" + uniqueName + entity.CommandSuffix;
+                add_command_topic(topics.CommandTopic, entity.OnCommand);
             }
-            publish_sensor_status<String>(F("mode_power"), status.power_as_string());
+
+            entityTopics.push_back(std::move(topics));
         }
+
+        add_command_topic(config.MqttTopic + F("/settings/set"), on_settings_command);
+        add_command_topic(F("homeassistant/status"), on_homeassistant_status);
+
+        std::sort(std::begin(commandTopics), std::end(commandTopics), [](const CommandTopic& a, const CommandTopic& b)
+        {
+            return a.Hash < b.Hash;
+        });
+
+        aggregatedValues.assign(ENTITY_COUNT, NAN);
+        aggregateStateTopic = config.MqttTopic + F("/state");
+        historyTopic = config.MqttTopic + F("/history");
     }
 
     void mqtt_callback(String& topic, String& payload)
     {
         try
         {
-            auto& config = config_instance();
-            String z1ClimateEntity = unique_entity_name(F("climate_control"));
-            String z2ClimateEntity = unique_entity_name(F("climate_control_z2"));
-            String z1TempCmdTopic = config.MqttTopic + "/" + z1ClimateEntity + F("/temp_cmd");
-            String z1FlowTargetCmdTopic = config.MqttTopic + "/" + unique_entity_name(F("z1_flow_temp_target")) + F("/set");
-            String z2TempCmdTopic = config.MqttTopic + "/" + z2ClimateEntity + F("/temp_cmd");
-            String z2FlowTargetCmdTopic = config.MqttTopic + "/" + unique_entity_name(F("z2_flow_temp_target")) + F("/set");
-            String dhwForceCmdTopic = config.MqttTopic + "/" + unique_entity_name(F("force_dhw")) + F("/set");
-            String turnOnOffCmdTopic = config.MqttTopic + "/" + unique_entity_name(F("turn_on_off_hp")) + F("/set");
-            String dhwTempCmdTopic = config.MqttTopic + "/" + unique_entity_name(F("dhw_water_heater")) + F("/set");
-            String dhwModeCmdTopic = config.MqttTopic + "/" + unique_entity_name(F("dhw_mode")) + F("/set");
-            String shModeCmdTopic = config.MqttTopic + "/" + unique_entity_name(F("sh_mode")) + F("/set");
-
             log_web(F("MQTT topic received: %s: '%s'"), topic.c_str(), payload.c_str());
 
-            if (z1TempCmdTopic == topic)
-            {
-                on_z1_temperature_set_command(payload);
-            }
-            else if (z1FlowTargetCmdTopic == topic)
-            {
-                on_z1_flow_target_temperature_set_command(payload);
-            }
-            else if (z2TempCmdTopic == topic)
-            {
-                on_z2_temperature_set_command(payload);
-            }
-            else if (z2FlowTargetCmdTopic == topic)
-            {
-                on_z2_flow_target_temperature_set_command(payload);
-            }
-            else if (dhwTempCmdTopic == topic)
+            uint32_t hash = fnv1a_hash(topic.c_str());
+            auto it = std::lower_bound(std::begin(commandTopics), std::end(commandTopics), hash, [](const CommandTopic& entry, uint32_t hash)
             {
-                on_dhw_temperature_set_command(payload);
-            }
-            else if (shModeCmdTopic == topic)
-            {
-                on_mode_set_command(payload);
-            }
-            else if (dhwModeCmdTopic == topic)
-            {
-                on_dhw_mode_set_command(payload);
-            }
-            else if (dhwForceCmdTopic == topic)
-            {
-                on_force_dhw_command(payload);
-            }
-            else if (turnOnOffCmdTopic == topic)
+                return entry.Hash < hash;
+            });
+
+            // Compare the full topic too, in case of a hash collision.
+            for (; it != std::end(commandTopics) && it->Hash == hash; ++it)
             {
-                on_turn_on_off_command(payload);
+                if (it->Topic == topic)
+                {
+                    it->Handler(payload);
+                    break;
+                }
             }
         }
         catch (std::exception const& ex)
@@ -447,37 +556,62 @@ off
         return true;
     }
 
-    bool periodic_update_tick()
+    String unique_entity_name(const String& name)
     {
-        if (!is_configured())
-            return false;
-
-        auto now = std::chrono::steady_clock::now();
-        static auto last_attempt = now + std::chrono::seconds(35);
-        static auto last_discover = now;
+        String stringName = name;
+        stringName.replace(" ", "_");
+        return  stringName + "_" + config_instance().UniqueId;
+    }
 
-        // Periodically re-publish discovery messages, just in case the broker missed them.
-        // This appears to happen if the MQTT connection is re-established after home assistant
-        // is restarted, and is still initializing.
-        if (now - last_discover > std::chrono::minutes(5))
+    // Index in ENTITIES of the entity which publishes the named state.
+    size_t state_entity_index(const char* name)
+    {
+        for (size_t i = 0; i < ENTITY_COUNT; ++i)
         {
-            last_discover = now;
-            needsAutoDiscover = true;
+            const Entity& entity = ENTITIES[i];
+            bool hasState = entity.Number != nullptr || entity.Binary != nullptr || entity.Text != nullptr;
+            if (hasState && strcmp(entity.Name, name) == 0)
+                return i;
         }
 
-        if ((now - last_attempt < std::chrono::seconds(30)))
-            return false;
+        return ENTITY_COUNT;
+    }
 
-        last_attempt = now;
+    const String& entity_state_topic(size_t index)
+    {
+        if (config_instance().MqttAggregateState)
+            return aggregateStateTopic;
 
-        return true;
+        return entityTopics.at(index).StateTopic;
     }
 
-    String unique_entity_name(const String& name)
+    const String& entity_state_topic(const char* name)
     {
-        String stringName = name;
-        stringName.replace(" ", "_");
-        return  stringName + "_" + config_instance().UniqueId;
+        return entity_state_topic(state_entity_index(name));
+    }
+
+    // Jinja expression which extracts an entity's value from a message on its state topic.
+    String entity_state_value(size_t index)
+    {
+        if (config_instance().MqttAggregateState)
+            return String(F("value_json.")) + entityTopics.at(index).Field;
+
+        return F("value");
+    }
+
+    String entity_state_value(const char* name)
+    {
+        return entity_state_value(state_entity_index(name));
+    }
+
+    String entity_value_template(size_t index, const char* filter = "")
+    {
+        return String(F("{{ ")) + entity_state_value(index) + filter + F(" }}");
+    }
+
+    String entity_value_template(const char* name, const char* filter = "")
+    {
+        return entity_value_template(state_entity_index(name), filter);
     }
 
     void add_discovery_device_object(JsonObject obj)
@@ -493,509 +627,251 @@ off
         device[F("cu")] = String(F("http://")) + WiFi.localIP().toString() + F("/configuration");
     }
 
-    bool publish_mqtt(const String& topic, const String& payload, bool retain = false)
+    bool publish_mqtt(const String& topic, const char* payload, size_t length, MessageClass messageClass, bool retain = false)
     {
-        const int RETRY_COUNT = 3;
-        for (int i = 0; i < RETRY_COUNT; ++i)
-        {
-            if (mqttClient.publish(topic, payload, retain, static_cast<int>(LWMQTT_QOS2)))
-            {
-                return true;
-            }
-            else
-            {
-                log_web(F("MQTT publishing failure: '%s': %d"), topic.c_str(), mqttClient.lastError());
-            }
+        currentCycle.Messages++;
+        currentCycle.BytesCopied += length; // Into the client's own buffer.
 
-            if (!mqttClient.connected())
-            {
-                log_web(F("MQTT network disconnection detected trying to publish: '%s' attempting to re-connect: %d/%d"), topic.c_str(), i+1, RETRY_COUNT);
-                connect_mqtt();
-            }
-        }
+        // Don't retry here, if the connection has dropped handle_loop() will re-establish it.
+        if (mqttClient.publish(topic.c_str(), payload, length, retain, message_qos(messageClass)))
+            return true;
 
-        needsAutoDiscover = true;
+        log_web(F("MQTT publishing failure: '%s': %d"), topic.c_str(), mqttClient.lastError());
         return false;
     }
 
-    bool publish_mqtt(const String& topic, const JsonDocument& json, bool retain = false)
+    // Serializes json into payloadBuffer, returning its length (or 0 if it doesn't fit).
+    size_t serialize_payload(const String& topic, const JsonDocument& json)
     {
-        String output;
-        serializeJson(json, output);
-        return publish_mqtt(topic, output, retain);
+        size_t length = serializeJson(json, payloadBuffer, sizeof(payloadBuffer));
+        if (length >= sizeof(payloadBuffer) - 1)
+        {
+            log_web(F("MQTT payload too large for buffer: %s"), topic.c_str());
+            return 0;
+        }
+
+        currentCycle.BytesCopied += length;
+        return length;
     }
 
-    bool publish_ha_climate_auto_discover()
+    // Discovery configs are retained, so each is only re-sent when its payload has changed since it
+    // was last published or HomeAssistant has restarted (see on_homeassistant_status()).
+    bool publish_discovery(const String& topic, const JsonDocument& json)
     {
-        // https://www.home-assistant.io/integrations/climate.mqtt/
-        String uniqueName = unique_entity_name(F("climate_control"));
+        size_t length = serialize_payload(topic, json);
+        if (length == 0)
+            return false;
 
-        const auto& config = config_instance();
-        String discoveryTopic = String(F("homeassistant/climate/")) + uniqueName + F("/config");
-        String stateTopic = config.MqttTopic + "/" + uniqueName + F("/state");
-        String tempCmdTopic = config.MqttTopic + "/" + uniqueName + F("/temp_cmd");
+        uint32_t hash = fnv1a_hash(payloadBuffer);
+        auto it = publishedDiscoveryHashes.find(topic);
+        if (it != std::end(publishedDiscoveryHashes) && it->second == hash)
+            return true;
 
-        JsonDocument doc;
-        JsonObject payloadJson = doc.to<JsonObject>();
-        payloadJson[F("name")] = uniqueName;
-        payloadJson[F("unique_id")] = uniqueName;
-        payloadJson[F("icon")] = F("mdi:heat-pump-outline");
+        if (!publish_mqtt(topic, payloadBuffer, length, MessageClass::DISCOVERY, /* retain =*/true))
+            return false;
 
-        add_discovery_device_object(payloadJson);
+        publishedDiscoveryHashes[topic] = hash;
+        return true;
+    }
 
-        payloadJson[F("mode_stat_t")] = stateTopic;
-        payloadJson[F("mode_stat_tpl")] = get_mode_status_template();
-        payloadJson[F("act_t")] = stateTopic;
-        payloadJson[F("act_tpl")] = get_action_status_template();
-        payloadJson[F("temp_stat_t")] = stateTopic;
-        payloadJson[F("temp_stat_tpl")] = get_temperature_status_template();
-        payloadJson[F("curr_temp_t")] = stateTopic;
-        payloadJson[F("curr_temp_tpl")] = get_current_temperature_status_template();
-        payloadJson[F("temp_cmd_t")] = tempCmdTopic;
-        payloadJson[F("temp_cmd_tpl")] = F("{{ value|float }}");
-        payloadJson[F("temp_cmd_tpl")] = F("{{ value }}");
+    std::chrono::seconds state_refresh_interval()
+    {
+        return std::chrono::seconds(std::min<uint16_t>(config_instance().MqttRefreshInterval, SENSOR_STATE_TIMEOUT / 2));
+    }
+
+    // Publishes a state only if it has moved by at least deadband (or for deadband 0, its payload has
+    // changed) since it was last published, or it is due a refresh so HomeAssistant doesn't expire it.
+    bool publish_state(const String& stateTopic, const char* payload, size_t length, float value = 0.0f, float deadband = 0.0f)
+    {
+        uint32_t hash = fnv1a_hash(payload);
+        auto refreshInterval = state_refresh_interval();
+        auto now = std::chrono::steady_clock::now();
 
+        auto it = publishedStates.find(stateTopic);
+        if (it != std::end(publishedStates) && now - it->second.PublishedAt < refreshInterval)
         {
-            auto& status = hp::get_status();
-            std::lock_guard<hp::Status> lock{status};
-
-            payloadJson[F("initial")] = status.Zone1SetTemperature;
-            payloadJson[F("min_temp")] = hp::get_min_thermostat_temperature();
-            payloadJson[F("max_temp")] = hp::get_max_thermostat_temperature();
-            payloadJson[F("temp_unit")] = "C";
-            payloadJson[F("temp_step")] = hp::get_temperature_step();
+            const PublishedState& last = it->second;
+            bool unchanged = deadband > 0.0f ? std::fabs(value - last.Value) < deadband : hash == last.PayloadHash;
+            if (unchanged)
+            {
+                ++suppressedCount;
+                return true;
+            }
         }
 
-        JsonArray modes = payloadJson["modes"].to<JsonArray>();
-        modes.add(F("heat"));
-        modes.add(F("off"));
-
-        if (!publish_mqtt(discoveryTopic, doc, /* retain =*/true))
-        {
-            log_web(F("Failed to publish homeassistant climate entity auto-discover"));
+        if (!publish_mqtt(stateTopic, payload, length, MessageClass::STATE))
             return false;
-        }
 
+        ++publishedCount;
+        publishedStates[stateTopic] = PublishedState{hash, value, now};
         return true;
     }
 
-    bool publish_ha_climate_z2_auto_discover()
+    bool publish_state(const String& stateTopic, const JsonDocument& json)
     {
-        // https://www.home-assistant.io/integrations/climate.mqtt/
-        String uniqueName = unique_entity_name(F("climate_control_z2"));
-
-        const auto& config = config_instance();
-        String discoveryTopic = String(F("homeassistant/climate/")) + uniqueName + F("/config");
-        String stateTopic = config.MqttTopic + "/" + uniqueName + F("/state");
-        String tempCmdTopic = config.MqttTopic + "/" + uniqueName + F("/temp_cmd");
-
-        JsonDocument doc;
-        JsonObject payloadJson = doc.to<JsonObject>();
-        payloadJson[F("name")] = uniqueName;
-        payloadJson[F("unique_id")] = uniqueName;
-        payloadJson[F("icon")] = F("mdi:heat-pump-outline");
-
-        add_discovery_device_object(payloadJson);
-
-        payloadJson[F("mode_stat_t")] = stateTopic;
-        payloadJson[F("mode_stat_tpl")] = get_mode_status_template();
-        payloadJson[F("act_t")] = stateTopic;
-        payloadJson[F("act_tpl")] = get_action_status_template();
-        payloadJson[F("temp_stat_t")] = stateTopic;
-        payloadJson[F("temp_stat_tpl")] = get_temperature_status_template();
-        payloadJson[F("curr_temp_t")] = stateTopic;
-        payloadJson[F("curr_temp_tpl")] = get_current_temperature_status_template();
-        payloadJson[F("temp_cmd_t")] = tempCmdTopic;
-        payloadJson[F("temp_cmd_tpl")] = F("{{ value|float }}");
-        payloadJson[F("temp_cmd_tpl")] = F("{{ value }}");
+        size_t length = serialize_payload(stateTopic, json);
+        if (length == 0)
+            return false;
 
-        {
-            auto& status = hp::get_status();
-            std::lock_guard<hp::Status> lock{status};
-
-            payloadJson[F("initial")] = status.Zone2SetTemperature;
-            payloadJson[F("min_temp")] = hp::get_min_thermostat_temperature();
-            payloadJson[F("max_temp")] = hp::get_max_thermostat_temperature();
-            payloadJson[F("temp_unit")] = "C";
-            payloadJson[F("temp_step")] = hp::get_temperature_step();
-        }
+        return publish_state(stateTopic, payloadBuffer, length);
+    }
 
-        JsonArray modes = payloadJson["modes"].to<JsonArray>();
+    void add_climate_discovery(JsonObject json, const String& stateTopic, const String& commandTopic, float initialTemperature)
+    {
+        // https://www.home-assistant.io/integrations/climate.mqtt/
+        json[F("mode_stat_t")] = stateTopic;
+        json[F("mode_stat_tpl")] = get_mode_status_template();
+        json[F("act_t")] = stateTopic;
+        json[F("act_tpl")] = get_action_status_template();
+        json[F("temp_stat_t")] = stateTopic;
+        json[F("temp_stat_tpl")] = get_temperature_status_template();
+        json[F("curr_temp_t")] = stateTopic;
+        json[F("curr_temp_tpl")] = get_current_temperature_status_template();
+        json[F("temp_cmd_t")] = commandTopic;
+        json[F("temp_cmd_tpl")] = F("{{ value }}");
+        json[F("initial")] = initialTemperature;
+        json[F("min_temp")] = hp::get_min_thermostat_temperature();
+        json[F("max_temp")] = hp::get_max_thermostat_temperature();
+        json[F("temp_unit")] = "C";
+        json[F("temp_step")] = hp::get_temperature_step();
+
+        JsonArray modes = json["modes"].to<JsonArray>();
         modes.add(F("heat"));
         modes.add(F("off"));
+    }
 
-        if (!publish_mqtt(discoveryTopic, doc, /* retain =*/true))
-        {
-            log_web(F("Failed to publish homeassistant climate entity auto-discover"));
-            return false;
-        }
-
-        return true;
+    void discover_climate_z1(JsonObject json, const String& stateTopic, const String& commandTopic)
+    {
+        add_climate_discovery(json, stateTopic, commandTopic, hp::get_status().Zone1SetTemperature);
     }
 
-    bool publish_ha_force_dhw_auto_discover()
+    void discover_climate_z2(JsonObject json, const String& stateTopic, const String& commandTopic)
     {
-        // https://www.home-assistant.io/integrations/switch.mqtt/
-        String uniqueName = unique_entity_name(F("force_dhw"));
+        add_climate_discovery(json, stateTopic, commandTopic, hp::get_status().Zone2SetTemperature);
+    }
 
-        const auto& config = config_instance();
-        String discoveryTopic = String(F("homeassistant/switch/")) + uniqueName + F("/config");
-        String stateTopic = config.MqttTopic + "/" + unique_entity_name(F("mode_dhw_forced")) + F("/state");
-        String cmdTopic = config.MqttTopic + "/" + uniqueName + F("/set");
+    void discover_flow_target(JsonObject json, const String& /* stateTopic */, const String& commandTopic)
+    {
+        // https://www.home-assistant.io/integrations/number.mqtt/
+        hp::Status status = hp::get_status();
 
-        JsonDocument doc;
-        JsonObject payloadJson = doc.to<JsonObject>();
-        payloadJson[F("name")] = uniqueName;
-        payloadJson[F("unique_id")] = uniqueName;
-        payloadJson[F("icon")] = F("mdi:toggle-switch-variant");
+        json[F("cmd_t")] = commandTopic;
+        json[F("cmd_tpl")] = F("{{ value }}");
+        json[F("min")] = String(hp::get_min_flow_target_temperature(status.hp_mode_as_string()));
+        json[F("max")] = String(hp::get_max_flow_target_temperature(status.hp_mode_as_string()));
+        json[F("step")] = 1;
+    }
 
-        add_discovery_device_object(payloadJson);
-
-        payloadJson[F("stat_t")] = stateTopic;
-        payloadJson[F("stat_t_tpl")] = F("{{ value }}");
-        payloadJson[F("stat_on")] = F("on");
-        payloadJson[F("stat_off")] = F("off");
-        payloadJson[F("cmd_t")] = cmdTopic;
-        payloadJson[F("cmd_tpl")] = F("{{ value }}");
-
-        if (!publish_mqtt(discoveryTopic, doc, /* retain =*/true))
-        {
-            log_web(F("Failed to publish homeassistant force DHW entity auto-discover"));
-            return false;
-        }
-
-        return true;
+    void add_switch_discovery(JsonObject json, const String& commandTopic, const __FlashStringHelper* stateOn, const __FlashStringHelper* stateOff)
+    {
+        // https://www.home-assistant.io/integrations/switch.mqtt/
+        json[F("stat_on")] = stateOn;
+        json[F("stat_off")] = stateOff;
+        json[F("cmd_t")] = commandTopic;
+        json[F("cmd_tpl")] = F("{{ value }}");
     }
 
-    bool publish_ha_set_z1_flow_target_auto_discover()
+    void discover_force_dhw(JsonObject json, const String& /* stateTopic */, const String& commandTopic)
     {
-        // https://www.home-assistant.io/integrations/number.mqtt/
-        String uniqueName = unique_entity_name(F("z1_flow_temp_target"));
-
-        const auto& config = config_instance();
-        auto& status = hp::get_status();
-        String discoveryTopic = String(F("homeassistant/number/")) + uniqueName + F("/config");
-        String stateTopic = config.MqttTopic + "/" + unique_entity_name(F("z1_flow_temp_target")) + F("/state");
-        String cmdTopic = config.MqttTopic + "/" + uniqueName + F("/set");
-
-        JsonDocument doc;
-        JsonObject payloadJson = doc.to<JsonObject>();
-        payloadJson[F("name")] = uniqueName;
-        payloadJson[F("unique_id")] = uniqueName;
-
-        add_discovery_device_object(payloadJson);
-
-        payloadJson[F("stat_t")] = stateTopic;
-        payloadJson[F("stat_t_tpl")] = F("{{ value }}");
-        payloadJson[F("cmd_t")] = cmdTopic;
-        payloadJson[F("cmd_tpl")] = F("{{ value }}");
-        payloadJson[F("min")] = String(ehal::hp::get_min_flow_target_temperature(status.hp_mode_as_string()));
-        payloadJson[F("max")] = String(ehal::hp::get_max_flow_target_temperature(status.hp_mode_as_string()));
-        payloadJson[F("step")] = 1;
-        payloadJson[F("dev_cla")] = F("temperature");
-        payloadJson[F("unit_of_meas")] = F("°C");
-        payloadJson[F("icon")] = String("mdi:thermometer-water");
-
-        if (!publish_mqtt(discoveryTopic, doc, /* retain =*/true))
-        {
-            log_web(F("Failed to publish homeassistant Z1 flow temperature set entity auto-discover"));
-            return false;
-        }
-
-        return true;
+        add_switch_discovery(json, commandTopic, F("on"), F("off"));
     }
 
-    bool publish_ha_turn_on_off_auto_discover()
+    void discover_power_switch(JsonObject json, const String& /* stateTopic */, const String& commandTopic)
     {
-        // https://www.home-assistant.io/integrations/switch.mqtt/
-        String uniqueName = unique_entity_name(F("turn_on_off_hp"));
-
-        const auto& config = config_instance();
-        String discoveryTopic = String(F("homeassistant/switch/")) + uniqueName + F("/config");
-        String stateTopic = config.MqttTopic + "/" + unique_entity_name(F("mode_power")) + F("/state");
-        String cmdTopic = config.MqttTopic + "/" + uniqueName + F("/set");
-
-        JsonDocument doc;
-        JsonObject payloadJson = doc.to<JsonObject>();
-        payloadJson[F("name")] = uniqueName;
-        payloadJson[F("unique_id")] = uniqueName;
-        payloadJson[F("icon")] = F("mdi:power");
-
-        add_discovery_device_object(payloadJson);
-
-        payloadJson[F("stat_t")] = stateTopic;
-        payloadJson[F("stat_t_tpl")] = F("{{ value }}");
-        payloadJson[F("stat_on")] = F("On");
-        payloadJson[F("stat_off")] = F("Standby");
-        payloadJson[F("cmd_t")] = cmdTopic;
-        payloadJson[F("cmd_tpl")] = F("{{ value }}");
-
-        if (!publish_mqtt(discoveryTopic, doc, /* retain =*/true))
-        {
-            log_web(F("Failed to publish homeassistant turn On/Off HP entity auto-discover"));
-            return false;
-        }
-
-        return true;
+        add_switch_discovery(json, commandTopic, F("On"), F("Standby"));
     }
 
-    bool publish_ha_set_dhw_temp_auto_discover()
+    void discover_water_heater(JsonObject json, const String& /* stateTopic */, const String& commandTopic)
     {
         // https://www.home-assistant.io/integrations/water_heater.mqtt/
-        String uniqueName = unique_entity_name(F("dhw_water_heater"));
-
         const auto& config = config_instance();
-        String discoveryTopic = String(F("homeassistant/water_heater/")) + uniqueName + F("/config");
-
-        JsonDocument doc;
-        JsonObject payloadJson = doc.to<JsonObject>();
-        payloadJson[F("name")] = uniqueName;
-        payloadJson[F("unique_id")] = uniqueName;
 
-        add_discovery_device_object(payloadJson);
-
-        payloadJson[F("curr_temp_t")] = config.MqttTopic + "/" + unique_entity_name(F("dhw_temp")) + F("/state");
-        payloadJson[F("temp_cmd_t")] = config.MqttTopic + "/" + uniqueName + F("/set");
-        payloadJson[F("temp_stat_t")] = config.MqttTopic + "/" + unique_entity_name(F("dhw_flow_temp_target")) + F("/state");
-        payloadJson[F("mode_stat_t")] = config.MqttTopic + "/" + unique_entity_name(F("mode_dhw")) + F("/state");
-        payloadJson[F("mode_stat_tpl")] = "{% if value==\"Eco\" %} eco {% elif value==\"Normal\" %} performance {% else %} off {% endif %}";
-        payloadJson[F("power_cmd_t")] = config.MqttTopic + "/" + unique_entity_name(F("mode_dhw_forced")) + F("/state");
-        payloadJson[F("mode_cmd_t")] = config.MqttTopic + "/" + unique_entity_name(F("dhw_mode")) + F("/set");
-        payloadJson[F("min_temp")] = String(ehal::hp::get_min_dhw_temperature());
-        payloadJson[F("max_temp")] = String(ehal::hp::get_max_dhw_temperature());
-        JsonArray modes = payloadJson["modes"].to<JsonArray>();
+        String dhwMode = entity_state_value("mode_dhw");
+        json[F("curr_temp_t")] = entity_state_topic("dhw_temp");
+        json[F("curr_temp_tpl")] = entity_value_template("dhw_temp");
+        json[F("temp_cmd_t")] = commandTopic;
+        json[F("temp_stat_t")] = entity_state_topic("dhw_flow_temp_target");
+        json[F("temp_stat_tpl")] = entity_value_template("dhw_flow_temp_target");
+        json[F("mode_stat_t")] = entity_state_topic("mode_dhw");
+        json[F("mode_stat_tpl")] = "{% if " + dhwMode + "==\"Eco\" %} eco {% elif " + dhwMode + "==\"Normal\" %} performance {% else %} off {% endif %}";
+        json[F("power_cmd_t")] = config.MqttTopic + "/" + unique_entity_name(F("mode_dhw_forced")) + F("/state");
+        json[F("mode_cmd_t")] = config.MqttTopic + "/" + unique_entity_name(F("dhw_mode")) + F("/set");
+        json[F("min_temp")] = String(hp::get_min_dhw_temperature());
+        json[F("max_temp")] = String(hp::get_max_dhw_temperature());
+        JsonArray modes = json["modes"].to<JsonArray>();
         modes.add("off");
         modes.add("eco");
         modes.add("performance");
-        payloadJson[F("temp_unit")] = "C";
-        payloadJson[F("precision")] = 0.5f;
-
-        if (!publish_mqtt(discoveryTopic, doc, /* retain =*/true))
-        {
-            log_web(F("Failed to publish homeassistant DHW temperature set entity auto-discover"));
-            return false;
-        }
-
-        return true;
+        json[F("temp_unit")] = "C";
+        json[F("precision")] = 0.5f;
     }
 
-    bool publish_ha_set_sh_mode_auto_discover()
+    void discover_sh_mode(JsonObject json, const String& /* stateTopic */, const String& commandTopic)
     {
         // https://www.home-assistant.io/integrations/select.mqtt/
-        String uniqueName = unique_entity_name(F("sh_mode"));
-
-        const auto& config = config_instance();
-        String discoveryTopic = String(F("homeassistant/select/")) + uniqueName + F("/config");
-
-        JsonDocument doc;
-        JsonObject payloadJson = doc.to<JsonObject>();
-        payloadJson[F("name")] = uniqueName;
-        payloadJson[F("unique_id")] = uniqueName;
-
-        add_discovery_device_object(payloadJson);
-
-        payloadJson[F("stat_t")] = config.MqttTopic + "/" + unique_entity_name(F("mode_heating_cooling")) + F("/state");
-        payloadJson[F("cmd_t")] = config.MqttTopic + "/" + unique_entity_name(F("sh_mode")) + F("/set");
-        JsonArray options = payloadJson["options"].to<JsonArray>();
+        json[F("cmd_t")] = commandTopic;
+        JsonArray options = json["options"].to<JsonArray>();
         options.add("Heat Target Temperature");
         options.add("Heat Flow Temperature");
         options.add("Heat Compensation Curve");
-        if (config.CoolEnabled) {
+        if (config_instance().CoolEnabled) {
           options.add("Cool Target Temperature");
           options.add("Cool Flow Temperature");
         }
-
-        if (!publish_mqtt(discoveryTopic, doc, /* retain =*/true))
-        {
-            log_web(F("Failed to publish homeassistant SH mode entity auto-discover"));
-            return false;
-        }
-
-        return true;
     }
 
-    bool publish_ha_binary_sensor_auto_discover(const String& name)
+    bool publish_entity_discovery(size_t index)
     {
-        const auto& config = config_instance();
-        String uniqueName = unique_entity_name(name);
-        String discoveryTopic = String(F("homeassistant/binary_sensor/")) + uniqueName + F("/config");
-        String stateTopic = config.MqttTopic + "/" + uniqueName + F("/state");
+        const Entity& entity = ENTITIES[index];
+        const EntityTopics& topics = entityTopics[index];
+        String uniqueName = unique_entity_name(entity.Name);
+        String discoveryTopic = String(F("homeassistant/")) + COMPONENT_NAMES[static_cast<size_t>(entity.Kind)] + "/" + uniqueName + F("/config");
+        bool diagnostic = entity.Flags & ENTITY_FLAG_DIAGNOSTIC;
 
-        // https://www.home-assistant.io/integrations/binary_sensor.mqtt/
-        JsonDocument doc;
+        // https://www.home-assistant.io/integrations/mqtt/
+        JsonDocument doc{&payloadAllocator};
         JsonObject payloadJson = doc.to<JsonObject>();
-        payloadJson[F("name")] = uniqueName;
+        payloadJson[F("name")] = diagnostic ? String(entity.Name) : uniqueName;
         payloadJson[F("unique_id")] = uniqueName;
 
         add_discovery_device_object(payloadJson);
 
-        payloadJson[F("stat_t")] = stateTopic;
-        payloadJson[F("payload_off")] = F("off");
-        payloadJson[F("payload_on")] = F("on");
-        payloadJson[F("exp_aft")] = SENSOR_STATE_TIMEOUT;
+        if (diagnostic)
+            payloadJson[F("entity_category")] = "diagnostic";
 
-        if (!publish_mqtt(discoveryTopic, doc))
+        if (entity.Number != nullptr || entity.Binary != nullptr || entity.Text != nullptr)
         {
-            log_web(F("Failed to publish homeassistant %s entity auto-discover"), uniqueName.c_str());
-            return false;
+            payloadJson[F("stat_t")] = entity_state_topic(index);
+            payloadJson[F("val_tpl")] = entity_value_template(index, entity.Number != nullptr && entity.Precision > 0 ? "|float" : "");
+            payloadJson[F("exp_aft")] = SENSOR_STATE_TIMEOUT;
         }
-
-        return true;
-    }
-
-    bool publish_ha_float_sensor_auto_discover(const String& name, SensorType type)
-    {
-        const auto& config = config_instance();
-        String uniqueName = unique_entity_name(name);
-        String discoveryTopic = String(F("homeassistant/sensor/")) + uniqueName + F("/config");
-        String stateTopic = config.MqttTopic + "/" + uniqueName + F("/state");
-
-        // https://www.home-assistant.io/integrations/sensor.mqtt/
-        JsonDocument doc;
-        JsonObject payloadJson = doc.to<JsonObject>();
-        payloadJson[F("name")] = uniqueName;
-        payloadJson[F("unique_id")] = uniqueName;
-
-        add_discovery_device_object(payloadJson);
-
-        payloadJson[F("stat_t")] = stateTopic;
-        payloadJson[F("val_tpl")] = F("{{ value|float }}");
-        payloadJson[F("exp_aft")] = SENSOR_STATE_TIMEOUT;
-
-        switch (type)
+        else if (entity.StateOf != nullptr)
         {
-        case SensorType::POWER:
-            payloadJson[F("unit_of_meas")] = F("kWh");
-            payloadJson[F("icon")] = F("mdi:lightning-bolt");
-            payloadJson[F("stat_cla")] = F("total");
-            payloadJson[F("dev_cla")] = F("energy");
-            break;
-
-        case SensorType::LIVE_POWER:
-            payloadJson[F("unit_of_meas")] = F("kW");
-            payloadJson[F("icon")] = F("mdi:lightning-bolt");
-            payloadJson[F("dev_cla")] = F("energy");
-            break;
-
-        case SensorType::FREQUENCY:
-            payloadJson[F("unit_of_meas")] = F("Hz");
-            payloadJson[F("icon")] = F("mdi:fan");
-            payloadJson[F("dev_cla")] = F("frequency");
-            break;
-
-        case SensorType::FLOW_RATE:
-            payloadJson[F("unit_of_meas")] = F("L/min");
-            payloadJson[F("icon")] = F("mdi:pump");
-            // payloadJson[F("dev_cla")] = F("water");
-            break;
-
-        case SensorType::TEMPERATURE:
-            payloadJson[F("unit_of_meas")] = F("°C");
-            payloadJson[F("dev_cla")] = F("temperature");
-            break;
-
-        case SensorType::COP:
-            payloadJson[F("icon")] = F("mdi:heat-pump-outline");
-            payloadJson[F("unit_of_meas")] = F("COP");
-            payloadJson[F("stat_cla")] = F("measurement");
-            break;
-
-        default:
-            break;
+            payloadJson[F("stat_t")] = entity_state_topic(entity.StateOf);
+            payloadJson[F("val_tpl")] = entity_value_template(entity.StateOf);
         }
 
-        if (!publish_mqtt(discoveryTopic, doc))
+        if (entity.Kind == Component::BINARY_SENSOR)
         {
-            log_web(F("Failed to publish homeassistant %s entity auto-discover"), uniqueName.c_str());
-            return false;
-        }
-
-        return true;
-    }
-
-    bool publish_ha_string_sensor_auto_discover(const String& name, const String& icon = "")
-    {
-        const auto& config = config_instance();
-        String uniqueName = unique_entity_name(name);
-        String discoveryTopic = String(F("homeassistant/sensor/")) + uniqueName + F("/config");
-        String stateTopic = config.MqttTopic + "/" + uniqueName + F("/state");
-
-        // https://www.home-assistant.io/integrations/sensor.mqtt/
-        JsonDocument doc;
-        JsonObject payloadJson = doc.to<JsonObject>();
-        payloadJson[F("name")] = uniqueName;
-        payloadJson[F("unique_id")] = uniqueName;
-
-        add_discovery_device_object(payloadJson);
-
-        payloadJson[F("stat_t")] = stateTopic;
-        payloadJson[F("val_tpl")] = F("{{ value }}");
-        payloadJson[F("exp_aft")] = SENSOR_STATE_TIMEOUT;
-
-        if (!icon.isEmpty())
-        {
-            payloadJson[F("icon")] = icon;
-        }
-
-        if (!publish_mqtt(discoveryTopic, doc))
-        {
-            log_web(F("Failed to publish homeassistant %s entity auto-discover"), uniqueName.c_str());
-            return false;
-        }
-
-        return true;
-    }
-
-    bool publish_ha_diagnostic_sensor_auto_discover(const String& name, SensorType type)
-    {
-        const auto& config = config_instance();
-        String uniqueName = unique_entity_name(name);
-        String discoveryTopic = String(F("homeassistant/sensor/")) + uniqueName + F("/config");
-        String stateTopic = config.MqttTopic + "/" + uniqueName + F("/state");
-
-        // https://www.home-assistant.io/integrations/sensor.mqtt/
-        JsonDocument doc;
-        JsonObject payloadJson = doc.to<JsonObject>();
-        payloadJson[F("name")] = name;
-        payloadJson[F("unique_id")] = uniqueName;
-
-        add_discovery_device_object(payloadJson);
-
-        payloadJson[F("entity_category")] = "diagnostic";
-        payloadJson[F("stat_t")] = stateTopic;
-        payloadJson[F("val_tpl")] = F("{{ value }}");
-        payloadJson[F("exp_aft")] = SENSOR_STATE_TIMEOUT;
-
-        switch (type)
-        {
-        case SensorType::CONNECTIVITY:
-            discoveryTopic = String(F("homeassistant/binary_sensor/")) + uniqueName + F("/config");
             payloadJson[F("payload_off")] = F("off");
             payloadJson[F("payload_on")] = F("on");
-            payloadJson[F("dev_cla")] = F("connectivity");
-            break;
-        case SensorType::WIFI_SIGNAL:
-            payloadJson[F("unit_of_meas")] = F("dBm");
-            payloadJson[F("icon")] = F("mdi:wifi");
-            payloadJson[F("dev_cla")] = F("signal_strength");
-            break;
-        case SensorType::WIFI_SSID:
-            payloadJson[F("icon")] = F("mdi:eye");
-            payloadJson[F("enabled_by_default")] = bool(false);
-            break;
-        case SensorType::IP_ADDRESS:
-            payloadJson[F("icon")] = F("mdi:ip");
-            payloadJson[F("enabled_by_default")] = bool(false);
-            break;
-        case SensorType::MAC_ADDRESS:
-            payloadJson[F("icon")] = F("mdi:eye");
-            payloadJson[F("enabled_by_default")] = bool(false);
-            break;
-        default:
-            break;
         }
 
-        if (!publish_mqtt(discoveryTopic, doc))
+        if (entity.Class.Unit != nullptr)
+            payloadJson[F("unit_of_meas")] = entity.Class.Unit;
+        if (entity.Class.DeviceClass != nullptr)
+            payloadJson[F("dev_cla")] = entity.Class.DeviceClass;
+        if (entity.Class.StateClass != nullptr)
+            payloadJson[F("stat_cla")] = entity.Class.StateClass;
+        if (entity.Class.Icon != nullptr)
+            payloadJson[F("icon")] = entity.Class.Icon;
+        if (entity.Flags & ENTITY_FLAG_DISABLED)
+            payloadJson[F("enabled_by_default")] = false;
+
+        if (entity.Discover != nullptr)
+            entity.Discover(payloadJson, topics.StateTopic, topics.CommandTopic);
+
+        if (!publish_discovery(discoveryTopic, doc))
         {
             log_web(F("Failed to publish homeassistant %s entity auto-discover"), uniqueName.c_str());
             return false;
@@ -1009,466 +885,488 @@ off
         if (!needsAutoDiscover)
             return;
 
-        // https://www.home-assistant.io/integrations/mqtt/
-        if (!publish_ha_climate_auto_discover())
-            return;
-
-        if (!publish_ha_climate_z2_auto_discover())
-            return;
-
-        if (!publish_ha_set_z1_flow_target_auto_discover())
-            return;
-
-        if (!publish_ha_force_dhw_auto_discover())
-            return;
-
-        if (!publish_ha_turn_on_off_auto_discover())
-            return;
-
-        if (!publish_ha_set_dhw_temp_auto_discover())
-            return;
-
-        if (!publish_ha_set_sh_mode_auto_discover())
-            return;
-
-        if (!publish_ha_binary_sensor_auto_discover(F("mode_defrost")))
-            return;
-
-        if (!publish_ha_float_sensor_auto_discover(F("compressor_frequency"), SensorType::FREQUENCY))
-            return;
-
-        if (!publish_ha_float_sensor_auto_discover(F("flow_rate"), SensorType::FLOW_RATE))
-            return;
-
-        if (!publish_ha_binary_sensor_auto_discover(F("mode_dhw_forced")))
-            return;
-
-        if (!publish_ha_float_sensor_auto_discover(F("output_pwr"), SensorType::LIVE_POWER))
-            return;
-
-        if (!publish_ha_float_sensor_auto_discover(F("legionella_prevention_temp"), SensorType::TEMPERATURE))
-            return;
-
-        if (!publish_ha_float_sensor_auto_discover(F("dhw_temp_drop"), SensorType::TEMPERATURE))
-            return;
-
-        if (!publish_ha_float_sensor_auto_discover(F("outside_temp"), SensorType::TEMPERATURE))
-            return;
-
-        if (!publish_ha_float_sensor_auto_discover(F("hp_feed_temp"), SensorType::TEMPERATURE))
-            return;
-
-        if (!publish_ha_float_sensor_auto_discover(F("hp_return_temp"), SensorType::TEMPERATURE))
-            return;
-
-        if (!publish_ha_float_sensor_auto_discover(F("boiler_flow_temp"), SensorType::TEMPERATURE))
-            return;
-
-        if (!publish_ha_float_sensor_auto_discover(F("boiler_return_temp"), SensorType::TEMPERATURE))
-            return;
-
-        if (!publish_ha_float_sensor_auto_discover(F("dhw_flow_temp_target"), SensorType::TEMPERATURE))
-            return;
-
-        if (!publish_ha_float_sensor_auto_discover(F("sh_flow_temp_target"), SensorType::TEMPERATURE))
-            return;
-
-        if (!publish_ha_string_sensor_auto_discover(F("mode_power")))
-            return;
+        PublishCycle cycle{discoveryCycleStats};
 
-        if (!publish_ha_string_sensor_auto_discover(F("mode_operation")))
-            return;
-
-        if (!publish_ha_string_sensor_auto_discover(F("mode_dhw")))
-            return;
-
-        if (!publish_ha_string_sensor_auto_discover(F("mode_heating_cooling")))
-            return;
-
-        if (!publish_ha_float_sensor_auto_discover(F("heating_consumed"), SensorType::POWER))
-            return;
-
-        if (!publish_ha_float_sensor_auto_discover(F("heating_delivered"), SensorType::POWER))
-            return;
-
-        if (!publish_ha_float_sensor_auto_discover(F("cooling_consumed"), SensorType::POWER))
-            return;
-
-        if (!publish_ha_float_sensor_auto_discover(F("cooling_delivered"), SensorType::POWER))
-            return;
-
-        if (!publish_ha_float_sensor_auto_discover(F("dhw_consumed"), SensorType::POWER))
-            return;
-
-        if (!publish_ha_float_sensor_auto_discover(F("dhw_delivered"), SensorType::POWER))
-            return;
-
-        if (!publish_ha_float_sensor_auto_discover(F("z1_room_temp"), SensorType::TEMPERATURE))
-            return;
-
-        if (!publish_ha_float_sensor_auto_discover(F("z1_flow_temp_target"), SensorType::TEMPERATURE))
-            return;
+        for (size_t i = 0; i < ENTITY_COUNT; ++i)
+        {
+            if (ENTITIES[i].Kind != Component::NONE && !publish_entity_discovery(i))
+                return;
+        }
 
-        if (!publish_ha_float_sensor_auto_discover(F("z1_room_temp_target"), SensorType::TEMPERATURE))
-            return;
+        needsAutoDiscover = false;
+    }
 
-        if (!publish_ha_float_sensor_auto_discover(F("z2_room_temp"), SensorType::TEMPERATURE))
-            return;
+    void add_climate_state(JsonObject json, hp::Status& status, float setTemperature, float roomTemperature)
+    {
+        json[F("temperature")] = round2(setTemperature);
+        json[F("curr_temp")] = round2(roomTemperature);
+        json[F("mode")] = status.ha_mode_as_string();
+        json[F("action")] = status.ha_action_as_string();
+    }
 
-        if (!publish_ha_float_sensor_auto_discover(F("z2_flow_temp_target"), SensorType::TEMPERATURE))
-            return;
+    void climate_z1_state(hp::Status& status, JsonObject json)
+    {
+        add_climate_state(json, status, status.Zone1SetTemperature, status.Zone1RoomTemperature);
+    }
 
-        if (!publish_ha_float_sensor_auto_discover(F("z2_room_temp_target"), SensorType::TEMPERATURE))
-            return;
+    void climate_z2_state(hp::Status& status, JsonObject json)
+    {
+        add_climate_state(json, status, status.Zone2SetTemperature, status.Zone2RoomTemperature);
+    }
 
-        if (!publish_ha_float_sensor_auto_discover(F("dhw_temp"), SensorType::TEMPERATURE))
-            return;
+    bool hp_connection_state(hp::Status& /* status */)
+    {
+        return hp::is_connected();
+    }
 
-        if (!publish_ha_float_sensor_auto_discover(F("dhw_cop"), SensorType::COP))
-            return;
+    float wifi_signal_state(hp::Status& /* status */)
+    {
+        return WiFi.RSSI();
+    }
 
-        if (!publish_ha_float_sensor_auto_discover(F("sh_cop"), SensorType::COP))
-            return;
+    String wifi_ssid_state(hp::Status& /* status */)
+    {
+        return WiFi.SSID();
+    }
 
-        if (!publish_ha_float_sensor_auto_discover(F("cool_cop"), SensorType::COP))
-            return;
+    String ip_address_state(hp::Status& /* status */)
+    {
+        return WiFi.localIP().toString();
+    }
 
-        // Diagnostic sensors
-        if (!publish_ha_diagnostic_sensor_auto_discover(F("Heat pump connection state"), SensorType::CONNECTIVITY))
-            return;
+    String mac_address_state(hp::Status& /* status */)
+    {
+        return WiFi.macAddress();
+    }
 
-        if (!publish_ha_diagnostic_sensor_auto_discover(F("Wifi signal"), SensorType::WIFI_SIGNAL))
-            return;
+    float backlog_state(hp::Status& /* status */)
+    {
+        return backlog::size();
+    }
 
-        if (!publish_ha_diagnostic_sensor_auto_discover(F("Wifi SSID"), SensorType::WIFI_SSID))
-            return;
+    bool publish_document_state(size_t index, hp::Status& status)
+    {
+        JsonDocument doc{&payloadAllocator};
+        ENTITIES[index].Document(status, doc.to<JsonObject>());
 
-        if (!publish_ha_diagnostic_sensor_auto_discover(F("IP address"), SensorType::IP_ADDRESS))
-            return;
+        if (!publish_state(entityTopics[index].StateTopic, doc))
+        {
+            log_web(F("Failed to publish MQTT state for: %s"), ENTITIES[index].Name);
+            return false;
+        }
 
-        if (!publish_ha_diagnostic_sensor_auto_discover(F("MAC address"), SensorType::MAC_ADDRESS))
-            return;
+        return true;
     }
 
-    bool publish_climate_status()
+    bool publish_binary_state(size_t index, bool on)
     {
-        JsonDocument doc;
-        JsonObject json = doc.to<JsonObject>();
-
+        const char* state = on ? "on" : "off";
 
+        if (aggregateState != nullptr)
         {
-            auto& status = hp::get_status();
-            std::lock_guard<hp::Status> lock{status};
-
-            json[F("temperature")] = round2(status.Zone1SetTemperature);
-            json[F("curr_temp")] = round2(status.Zone1RoomTemperature);
-            json[F("mode")] = status.ha_mode_as_string();
-            json[F("action")] = status.ha_action_as_string();
+            (*aggregateState)[entityTopics[index].Field] = state;
+            return true;
         }
 
-        const auto& config = config_instance();
-        String stateTopic = config.MqttTopic + "/" + unique_entity_name(F("climate_control")) + F("/state");
-        if (!publish_mqtt(stateTopic, doc))
+        if (!publish_state(entityTopics[index].StateTopic, state, strlen(state)))
         {
-            log_web(F("Failed to publish MQTT state for: %s"), unique_entity_name(F("climate_control")).c_str());
+            log_web(F("Failed to publish MQTT state for: %s"), ENTITIES[index].Name);
             return false;
         }
 
         return true;
     }
 
-    bool publish_z2_climate_status()
+    bool publish_number_state(size_t index, float value, float deadband)
     {
-        JsonDocument doc;
-        JsonObject json = doc.to<JsonObject>();
-
+        const Entity& entity = ENTITIES[index];
 
+        if (aggregateState != nullptr)
         {
-            auto& status = hp::get_status();
-            std::lock_guard<hp::Status> lock{status};
+            // Hold a field at its last value until it leaves the deadband, so that jitter in one
+            // temperature doesn't make the whole document differ from the last one published.
+            if (aggregateDeadband)
+            {
+                float& last = aggregatedValues[index];
+                if (deadband > 0.0f && std::fabs(value - last) < deadband)
+                    value = last;
+                else
+                    last = value;
+            }
 
-            json[F("temperature")] = round2(status.Zone2SetTemperature);
-            json[F("curr_temp")] = round2(status.Zone2RoomTemperature);
-            json[F("mode")] = status.ha_mode_as_string();
-            json[F("action")] = status.ha_action_as_string();
+            double scale = std::pow(10.0, entity.Precision);
+            (*aggregateState)[entityTopics[index].Field] = std::round(value * scale) / scale;
+            return true;
         }
 
-        const auto& config = config_instance();
-        String stateTopic = config.MqttTopic + "/" + unique_entity_name(F("climate_control_z2")) + F("/state");
-        if (!publish_mqtt(stateTopic, doc))
+        size_t length = snprintf(payloadBuffer, sizeof(payloadBuffer), "%.*f", entity.Precision, value);
+        if (!publish_state(entityTopics[index].StateTopic, payloadBuffer, length, value, deadband))
         {
-            log_web(F("Failed to publish MQTT state for: %s"), unique_entity_name(F("climate_control_z2")).c_str());
+            log_web(F("Failed to publish MQTT state for: %s"), entity.Name);
             return false;
         }
 
         return true;
     }
 
-    bool publish_binary_sensor_status(const String& name, bool on)
+    bool publish_text_state(size_t index, const String& value)
     {
-        String state = on ? F("on") : F("off");
-        const auto& config = config_instance();
-        String stateTopic = config.MqttTopic + "/" + unique_entity_name(name) + F("/state");
-        if (!publish_mqtt(stateTopic, state))
+        if (aggregateState != nullptr)
         {
-            log_web(F("Failed to publish MQTT state for: %s"), unique_entity_name(name).c_str());
+            (*aggregateState)[entityTopics[index].Field] = value;
+            return true;
+        }
+
+        if (!publish_state(entityTopics[index].StateTopic, value.c_str(), value.length()))
+        {
+            log_web(F("Failed to publish MQTT state for: %s"), ENTITIES[index].Name);
             return false;
         }
 
         return true;
     }
 
-    template <typename T>
-    bool publish_sensor_status(const String& name, T value)
+    // Publishes (or adds to the single state topic document) the entities' scalar states, skipping those
+    // whose source fields aren't in changedFields.
+    bool publish_entity_states(hp::Status& status, bool includeDiagnostics, uint64_t changedFields = hp::ALL_REGISTER_FIELDS)
     {
-        const auto& config = config_instance();
-        String stateTopic = config.MqttTopic + "/" + unique_entity_name(name) + F("/state");
-        if (!publish_mqtt(stateTopic, String(value)))
+        float tempDeadband = config_instance().MqttTempDeadband;
+
+        for (size_t i = 0; i < ENTITY_COUNT; ++i)
         {
-            log_web(F("Failed to publish MQTT state for: %s"), unique_entity_name(name).c_str());
-            return false;
+            const Entity& entity = ENTITIES[i];
+            if ((entity.Flags & ENTITY_FLAG_DIAGNOSTIC) && !includeDiagnostics)
+                continue;
+
+            if ((entity.SourceFields & changedFields) == 0)
+                continue;
+
+            bool published = true;
+            if (entity.Number != nullptr)
+                published = publish_number_state(i, entity.Number(status), (entity.Flags & ENTITY_FLAG_TEMP_DEADBAND) ? tempDeadband : 0.0f);
+            else if (entity.Binary != nullptr)
+                published = publish_binary_state(i, entity.Binary(status));
+            else if (entity.Text != nullptr)
+                published = publish_text_state(i, entity.Text(status));
+
+            if (!published)
+                return false;
         }
 
         return true;
     }
 
-    void publish_entity_state_updates()
+    bool client_connected()
     {
-        if (!mqttClient.connected())
-            return;
+        return connectionState == ConnectionState::CONNECTED && mqttClient.connected();
+    }
 
-        if (!publish_climate_status())
-            return;
+    bool publish_entity_state_updates(uint64_t changedFields)
+    {
+        hp::Status status = hp::get_status();
 
-        if (!publish_z2_climate_status())
-            return;
+        if (!client_connected())
+            return false;
 
-        auto& status = hp::get_status();
-        std::lock_guard<hp::Status> lock{status};
-        if (!publish_binary_sensor_status(F("mode_defrost"), status.DefrostActive))
-            return;
+        PublishCycle cycle{stateCycleStats};
 
-        if (!publish_sensor_status<float>(F("compressor_frequency"), status.CompressorFrequency))
-            return;
+        // Entities whose registers didn't change are skipped, except on a periodic full pass which keeps
+        // their refreshes (see publish_state) going, and after (re)connecting when nothing has been published.
+        auto now = std::chrono::steady_clock::now();
+        if (publishedStates.empty() || now - lastFullStatePass >= state_refresh_interval() / 2)
+        {
+            changedFields = hp::ALL_REGISTER_FIELDS;
+            lastFullStatePass = now;
+        }
 
-        if (!publish_sensor_status<float>(F("flow_rate"), status.FlowRate))
-            return;
+        // Document states (the climate entities) always publish to their own topics.
+        for (size_t i = 0; i < ENTITY_COUNT; ++i)
+        {
+            if (ENTITIES[i].Document != nullptr && !publish_document_state(i, status))
+                return false;
+        }
 
-        if (!publish_binary_sensor_status(F("mode_dhw_forced"), status.DhwForcedActive))
-            return;
+        const auto& config = config_instance();
+        if (!config.MqttAggregateState)
+        {
+            if (publish_entity_states(status, /* includeDiagnostics =*/true, changedFields))
+                return true;
 
-        if (!publish_sensor_status<float>(F("output_pwr"), status.OutputPower))
-            return;
+            lastFullStatePass = {}; // Entities after the failure missed this cycle's changes.
+            return false;
+        }
 
-        if (!publish_sensor_status<float>(F("legionella_prevention_temp"), status.LegionellaPreventionSetPoint))
-            return;
+        // Everything else lands in one document.
+        JsonDocument doc{&payloadAllocator};
+        aggregateState = &doc;
+        publish_entity_states(status, /* includeDiagnostics =*/true);
+        aggregateState = nullptr;
 
-        if (!publish_sensor_status<float>(F("dhw_temp_drop"), status.DhwTemperatureDrop))
-            return;
+        if (!publish_state(aggregateStateTopic, doc))
+        {
+            log_web(F("Failed to publish MQTT state document: %s/state"), config.MqttTopic.c_str());
+            return false;
+        }
 
-        if (!publish_sensor_status<float>(F("outside_temp"), status.OutsideTemperature))
-            return;
+        return true;
+    }
 
-        if (!publish_sensor_status<float>(F("hp_feed_temp"), status.DhwFeedTemperature))
-            return;
+    // Publishes a status update which was held while MQTT was unavailable, as one JSON document (with
+    // the same fields as the single state topic, plus its timestamp) on <MqttTopic>/history. Replaying
+    // it to the live state topics would just make HomeAssistant record stale values as current.
+    bool publish_backlog_sample(backlog::Sample& sample)
+    {
+        JsonDocument doc{&payloadAllocator};
+        doc[F("ts")] = sample.Timestamp;
 
-        if (!publish_sensor_status<float>(F("hp_return_temp"), status.DhwReturnTemperature))
-            return;
+        aggregateState = &doc;
+        aggregateDeadband = false;
+        publish_entity_states(sample.Status, /* includeDiagnostics =*/false);
+        aggregateDeadband = true;
+        aggregateState = nullptr;
 
-        if (!publish_sensor_status<float>(F("boiler_flow_temp"), status.BoilerFlowTemperature))
-            return;
+        size_t length = serialize_payload(historyTopic, doc);
+        if (length == 0)
+            return false;
 
-        if (!publish_sensor_status<float>(F("boiler_return_temp"), status.BoilerReturnTemperature))
-            return;
+        return publish_mqtt(historyTopic, payloadBuffer, length, MessageClass::STATE);
+    }
 
-        if (!publish_sensor_status<float>(F("dhw_flow_temp_target"), status.DhwFlowTemperatureSetPoint))
-            return;
+    void drain_backlog()
+    {
+        auto now = std::chrono::steady_clock::now();
+        static auto lastDrain = now;
 
-        if (!publish_sensor_status<float>(F("sh_flow_temp_target"), status.RadiatorFlowTemperatureSetPoint))
+        if (now - lastDrain < std::chrono::milliseconds(BACKLOG_DRAIN_INTERVAL_MS))
             return;
 
-        if (!publish_sensor_status<String>(F("mode_power"), status.power_as_string()))
-            return;
+        lastDrain = now;
 
-        if (!publish_sensor_status<String>(F("mode_operation"), status.operation_as_string()))
-            return;
+        backlog::Sample sample;
+        for (int i = 0; i < BACKLOG_DRAIN_BATCH && backlog::peek(sample); ++i)
+        {
+            if (!publish_backlog_sample(sample))
+                return;
 
-        if (!publish_sensor_status<String>(F("mode_dhw"), status.dhw_mode_as_string()))
-            return;
+            backlog::pop();
+        }
+    }
 
-        if (!publish_sensor_status<String>(F("mode_heating_cooling"), status.hp_mode_as_string()))
-            return;
+    void schedule_connect_attempt()
+    {
+        // Exponential backoff with jitter: wait somewhere in [backoff/2, backoff), so that several
+        // devices dropped by the same broker restart don't all reconnect in lockstep.
+        connectBackoffMs = std::min<uint32_t>(connectBackoffMs == 0 ? CONNECT_BACKOFF_MIN_MS : connectBackoffMs * 2, CONNECT_BACKOFF_MAX_MS);
+        uint32_t delayMs = connectBackoffMs / 2 + random(connectBackoffMs / 2);
 
-        if (!publish_sensor_status<float>(F("heating_consumed"), status.EnergyConsumedHeating))
-            return;
+        {
+            std::lock_guard<std::mutex> lock{connectionStatsMutex};
+            nextConnectAttempt = std::chrono::steady_clock::now() + std::chrono::milliseconds(delayMs);
+        }
 
-        if (!publish_sensor_status<float>(F("heating_delivered"), status.EnergyDeliveredHeating))
-            return;
+        connectionState = ConnectionState::DISCONNECTED;
+    }
 
-        if (!publish_sensor_status<float>(F("cooling_consumed"), status.EnergyConsumedCooling))
-            return;
+    void record_connect_attempt(uint32_t elapsedMs, bool connected)
+    {
+        std::lock_guard<std::mutex> lock{connectionStatsMutex};
+        totalConnectAttemptMs += elapsedMs;
+        connectionStats.Attempts++;
+        connectionStats.LastAttemptMs = elapsedMs;
+        connectionStats.AverageAttemptMs = totalConnectAttemptMs / connectionStats.Attempts;
+        connectionStats.MaxAttemptMs = std::max(connectionStats.MaxAttemptMs, elapsedMs);
+
+        if (!connected)
+            connectionStats.Failures++;
+    }
 
-        if (!publish_sensor_status<float>(F("cooling_delivered"), status.EnergyDeliveredCooling))
-            return;
+    // Opens the TCP connection to the broker with a short timeout, so that an unreachable broker doesn't
+    // hold up the MQTT task for the client's (much longer) command timeout.
+    bool connect_tcp()
+    {
+        Config& config = config_instance();
+        auto start = std::chrono::steady_clock::now();
 
-        if (!publish_sensor_status<float>(F("dhw_consumed"), status.EnergyConsumedDhw))
-            return;
+        bool connected = espClient.connect(config.MqttServer.c_str(), config.MqttPort, CONNECT_TCP_TIMEOUT_MS);
+        tcpConnectMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
 
-        if (!publish_sensor_status<float>(F("dhw_delivered"), status.EnergyDeliveredDhw))
-            return;
+        if (!connected)
+        {
+            log_web(F("MQTT connection failure: unable to reach %s:%u"), config.MqttServer.c_str(), config.MqttPort);
+            record_connect_attempt(tcpConnectMs, false);
+        }
 
-        if (!publish_sensor_status<float>(F("z1_room_temp"), status.Zone1RoomTemperature))
-            return;
+        return connected;
+    }
 
-        if (!publish_sensor_status<float>(F("z1_flow_temp_target"), status.Zone1FlowTemperatureSetPoint))
-            return;
+    // Performs the MQTT handshake over the TCP connection opened by connect_tcp().
+    bool attempt_connect()
+    {
+        Config& config = config_instance();
+        auto start = std::chrono::steady_clock::now();
+        bool connected;
 
-        if (!publish_sensor_status<float>(F("z1_room_temp_target"), status.Zone1SetTemperature))
-            return;
+        if (!config.MqttPassword.isEmpty() && !config.MqttUserName.isEmpty())
+        {
+            log_web(F("MQTT user '%s' has configured password, connecting with credentials..."), config.MqttUserName.c_str());
+            connected = mqttClient.connect(WiFi.localIP().toString().c_str(), config.MqttUserName.c_str(), config.MqttPassword.c_str(), /* skip =*/true);
+        }
+        else
+        {
+            log_web(F("MQTT username/password not configured, connecting as anonymous user..."));
+            connected = mqttClient.connect(WiFi.localIP().toString().c_str(), nullptr, nullptr, /* skip =*/true);
+        }
 
-        if (!publish_sensor_status<float>(F("z2_room_temp"), status.Zone2RoomTemperature))
-            return;
+        uint32_t elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        record_connect_attempt(tcpConnectMs + elapsedMs, connected);
 
-        if (!publish_sensor_status<float>(F("z2_flow_temp_target"), status.Zone2FlowTemperatureSetPoint))
-            return;
+        if (!connected)
+        {
+            log_web(F("MQTT connection failure: '%s'"), get_connection_error_string().c_str());
+            espClient.stop();
+        }
 
-        if (!publish_sensor_status<float>(F("z2_room_temp_target"), status.Zone2SetTemperature))
-            return;
+        return connected;
+    }
 
-        if (!publish_sensor_status<float>(F("dhw_temp"), status.DhwTemperature))
-            return;
+    void update_connection()
+    {
+        switch (connectionState.load())
+        {
+        case ConnectionState::DISCONNECTED:
+            if (std::chrono::steady_clock::now() < nextConnectAttempt)
+                return;
 
-        if (!publish_sensor_status<float>(F("dhw_cop"), status.EnergyConsumedDhw > 0.0f ? status.EnergyDeliveredDhw / status.EnergyConsumedDhw : 0.0f))
-            return;
+            if (!connect_tcp())
+            {
+                schedule_connect_attempt();
+                return;
+            }
 
-        if (!publish_sensor_status<float>(F("sh_cop"), status.EnergyConsumedHeating > 0.0f ? status.EnergyDeliveredHeating / status.EnergyConsumedHeating : 0.0f))
-            return;
-        
-        if (!publish_sensor_status<float>(F("cool_cop"), status.EnergyConsumedCooling > 0.0f ? status.EnergyDeliveredCooling / status.EnergyConsumedCooling : 0.0f))
+            connectionState = ConnectionState::HANDSHAKE;
             return;
 
-        // Diagnostic
-        if (!publish_binary_sensor_status(F("Heat pump connection state"), hp::is_connected()))
-            return;
+        case ConnectionState::HANDSHAKE:
+            if (!attempt_connect())
+            {
+                schedule_connect_attempt();
+                return;
+            }
 
-        if (!publish_sensor_status<int>(F("Wifi signal"), int(WiFi.RSSI())))
+            needsAutoDiscover = true;
+            publishedStates.clear(); // The broker may not have seen anything we published before the disconnect.
+            std::fill(std::begin(aggregatedValues), std::end(aggregatedValues), NAN);
+            nextSubscription = 0;
+            connectionState = ConnectionState::SUBSCRIBING;
             return;
 
-        if (!publish_sensor_status<String>(F("Wifi SSID"), WiFi.SSID()))
-            return;
+        case ConnectionState::SUBSCRIBING:
+            if (nextSubscription < commandTopics.size())
+            {
+                const auto& command = commandTopics[nextSubscription++];
+                if (!mqttClient.subscribe(command.Topic, message_qos(MessageClass::COMMAND)))
+                {
+                    log_web(F("Failed to subscribe to command topic: %s"), command.Topic.c_str());
+                    mqttClient.disconnect();
+                    schedule_connect_attempt();
+                }
+                return;
+            }
 
-        if (!publish_sensor_status<String>(F("IP address"), WiFi.localIP().toString()))
+            log_web(F("Successfully established MQTT client connection!"));
+            connectBackoffMs = 0;
+            connectionState = ConnectionState::CONNECTED;
+            publish_homeassistant_auto_discover();
             return;
 
-        if (!publish_sensor_status<String>(F("MAC address"), WiFi.macAddress()))
+        case ConnectionState::CONNECTED:
+            if (!mqttClient.connected())
+            {
+                log_web(F("MQTT disconnect detected, reconnecting..."));
+
+                {
+                    std::lock_guard<std::mutex> lock{connectionStatsMutex};
+                    connectionStats.Disconnects++;
+                }
+
+                schedule_connect_attempt();
+            }
             return;
+        }
     }
 
-    bool connect_mqtt()
+    void handle_loop()
     {
-        if (mqttClient.connected())
-            return true;
-
-        Config& config = config_instance();
-        if (!config.MqttPassword.isEmpty() && !config.MqttUserName.isEmpty())
+        // Re-establish MQTT connection if we need to.
+        update_connection();
+
+        // Publish as soon as the heat pump finishes a poll cycle, rather than on a timer of our own.
+        bool pollCycleComplete = false;
+        uint64_t changedFields = 0;
+        hp::StatusDelta delta;
+        while (hp::pop_status_delta(delta))
         {
-            log_web(F("MQTT user '%s' has configured password, connecting with credentials..."), config.MqttUserName.c_str());
-            int mqtt_connection_retries = 0;
-            while (!mqttClient.connect(WiFi.localIP().toString().c_str(), config.MqttUserName.c_str(), config.MqttPassword.c_str())) 
-            {
-                log_web(F("Connecting to MQTT server ..."));
-                delay(1000);
-                if (mqtt_connection_retries > 10) 
-                {
-                    break;
-                }
-                mqtt_connection_retries++;
-            }
-            if (mqtt_connection_retries > 10)
-            {
-                log_web(F("MQTT connection failure: '%s'"), get_connection_error_string().c_str());
-                return false;
-            }
+            pollCycleComplete = true;
+            changedFields |= delta.ChangedFields;
         }
-        else
+
+        // A delta dropped because the queue was full took its changed fields with it.
+        uint32_t overflows = hp::get_status_delta_overflow_count();
+        if (overflows != statusDeltaOverflowsSeen)
         {
-            log_web(F("MQTT username/password not configured, connecting as anonymous user..."));
-            int mqtt_connection_retries = 0;
-            while (!mqttClient.connect(WiFi.localIP().toString().c_str())) 
-            {
-                log_web(F("Connecting to MQTT server ..."));
-                delay(1000);
-                if (mqtt_connection_retries > 10) 
-                {
-                    break;
-                }
-                mqtt_connection_retries++;
-            }
-            if (mqtt_connection_retries > 10)
-            {
-                log_web(F("MQTT connection failure: '%s'"), get_connection_error_string().c_str());
-                return false;
-            }
+            statusDeltaOverflowsSeen = overflows;
+            changedFields = hp::ALL_REGISTER_FIELDS;
         }
 
-        if (mqttClient.connected())
+        if (hp::is_connected())
         {
-            needsAutoDiscover = true;
+            // Publish homeassistant auto-discovery messages if we need to.
+            if (client_connected())
+                publish_homeassistant_auto_discover();
 
-            String tempCmdTopic = config.MqttTopic + "/" + unique_entity_name(F("climate_control")) + F("/temp_cmd");
-            if (!mqttClient.subscribe(tempCmdTopic))
+            if (pollCycleComplete && !publish_entity_state_updates(changedFields))
             {
-                log_web(F("Failed to subscribe to temperature command topic!"));
-                return false;
-            }
+                // Hold on to the update if the broker can't be reached.
+                auto now = std::chrono::steady_clock::now();
+                static auto lastBacklogSample = now - std::chrono::milliseconds(BACKLOG_SAMPLE_INTERVAL_MS);
 
-            String z2TempCmdTopic = config.MqttTopic + "/" + unique_entity_name(F("climate_control_z2")) + F("/temp_cmd");
-            if (!mqttClient.subscribe(z2TempCmdTopic))
-            {
-                log_web(F("Failed to subscribe to Z2 temperature command topic!"));
-                return false;
+                if (now - lastBacklogSample >= std::chrono::milliseconds(BACKLOG_SAMPLE_INTERVAL_MS))
+                {
+                    lastBacklogSample = now;
+                    backlog::push(hp::get_status());
+                }
             }
 
-            if (!mqttClient.subscribe(config.MqttTopic + "/" + unique_entity_name(F("force_dhw")) + F("/set")))
-            {
-                log_web(F("Failed to subscribe to boost DHW command topic!"));
-                return false;
-            }
+            if (client_connected())
+                drain_backlog();
+        }
 
-            if (!mqttClient.subscribe(config.MqttTopic + "/" + unique_entity_name(F("turn_on_off_hp")) + F("/set")))
-            {
-                log_web(F("Failed to subscribe to turn ON/OFF command topic!"));
-                return false;
-            }
+        mqttClient.loop();
+    }
 
-            if (!mqttClient.subscribe(config.MqttTopic + "/" + unique_entity_name(F("dhw_water_heater")) + F("/set")))
-            {
-                log_web(F("Failed to subscribe to DHW temperature topic!"));
-                return false;
-            }
+    void mqtt_thread()
+    {
+        hal::add_thread_to_watchdog();
 
-            if (!mqttClient.subscribe(config.MqttTopic + "/" + unique_entity_name(F("z1_flow_temp_target")) + F("/set")))
-            {
-                log_web(F("Failed to subscribe to Z1 flow target temperature command topic!"));
-                return false;
-            }
+        hp::set_status_delta_consumer(hal::current_task());
 
-            if (!mqttClient.subscribe(config.MqttTopic + "/" + unique_entity_name(F("dhw_mode")) + F("/set")))
+        while (true)
+        {
+            try
             {
-                log_web(F("Failed to subscribe to DHW mode command topic!"));
-                return false;
-            }
+                hal::ping_watchdog();
 
-            if (!mqttClient.subscribe(config.MqttTopic + "/" + unique_entity_name(F("sh_mode")) + F("/set")))
+                handle_loop();
+            }
+            catch (std::exception const& ex)
             {
-                log_web(F("Failed to subscribe to SH mode command topic!"));
-                return false;
+                ehal::log_web(F("Exception occurred on MQTT thread: %s"), ex.what());
+                std::this_thread::sleep_for(std::chrono::seconds(1));
             }
 
-            log_web(F("Successfully established MQTT client connection!"));
+            // Woken early when the heat pump posts a status delta.
+            hal::wait_for_notification(MQTT_TASK_IDLE_MS);
         }
-
-        return true;
     }
 
     bool initialize()
@@ -1488,46 +1386,57 @@ off
         const bool USE_CLEAN_SESSION = false; // Persistent MQTT session
         const int COMMAND_TIMEOUT_MILLISECONDS = 10000;
         mqttClient.setOptions(KEEPALIVE_TIME_SECONDS, USE_CLEAN_SESSION, COMMAND_TIMEOUT_MILLISECONDS);
+        build_topic_registry();
         mqttClient.onMessage(mqtt_callback);
         mqttClient.begin(config.MqttServer.c_str(), config.MqttPort, espClient);
 
-        if (connect_mqtt())
-        {
-            publish_homeassistant_auto_discover();
-        }
+        connectionState = ConnectionState::DISCONNECTED;
+        nextConnectAttempt = std::chrono::steady_clock::now();
+
+        // From here on the MQTT client is only touched by the MQTT task.
+        mqttThread = hal::start_thread("mqtt", config.MqttTaskCore, MQTT_TASK_STACK_SIZE, mqtt_thread);
 
         return true;
     }
 
-    void handle_loop()
+    bool is_connected()
     {
-        if (hp::is_connected())
+        return connectionState == ConnectionState::CONNECTED;
+    }
+
+    ConnectionStats get_connection_stats()
+    {
+        std::lock_guard<std::mutex> lock{connectionStatsMutex};
+        ConnectionStats stats = connectionStats;
+
+        if (connectionState == ConnectionState::DISCONNECTED)
         {
-            if (periodic_update_tick())
-            {
-                // If homeassistant restarts, we'll need to re-publish auto-discovery
-                if (!mqttClient.connected())
-                {
-                    log_web(F("MQTT disconnect detected during periodic update check!"));
-                    needsAutoDiscover = true;
-                }
+            auto wait = nextConnectAttempt - std::chrono::steady_clock::now();
+            stats.NextAttemptInMs = std::max<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(wait).count(), 0);
+        }
 
-                // Re-establish MQTT connection if we need to.
-                connect_mqtt();
+        return stats;
+    }
 
-                // Publish homeassistant auto-discovery messages if we need to.
-                publish_homeassistant_auto_discover();
+    uint64_t get_published_count()
+    {
+        return publishedCount;
+    }
 
-                // Update all entity statuses.
-                publish_entity_state_updates();
-            }
-        }
+    uint64_t get_suppressed_count()
+    {
+        return suppressedCount;
+    }
 
-        mqttClient.loop();
+    PublishCycleStats get_state_cycle_stats()
+    {
+        std::lock_guard<std::mutex> lock{publishCycleStatsMutex};
+        return stateCycleStats;
     }
 
-    bool is_connected()
+    PublishCycleStats get_discovery_cycle_stats()
     {
-        return mqttClient.connected();
+        std::lock_guard<std::mutex> lock{publishCycleStatsMutex};
+        return discoveryCycleStats;
     }
 } // namespace ehal::mqtt
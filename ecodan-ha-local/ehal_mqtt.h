@@ -4,7 +4,34 @@ namespace ehal::mqtt
 {
     String unique_entity_name(const String& name);
 
+    // Starts the MQTT task, which owns the MQTT client from then on.
     bool initialize();
-    void handle_loop();
     bool is_connected();
+
+    struct ConnectionStats
+    {
+        uint32_t Attempts;
+        uint32_t Failures;
+        uint32_t Disconnects;
+        uint32_t LastAttemptMs;
+        uint32_t AverageAttemptMs;
+        uint32_t MaxAttemptMs;
+        uint32_t NextAttemptInMs; // 0 unless waiting to reconnect
+    };
+
+    ConnectionStats get_connection_stats();
+
+    uint64_t get_published_count();
+    uint64_t get_suppressed_count();
+
+    // Cost of the most recent state update / discovery pass.
+    struct PublishCycleStats
+    {
+        uint32_t Messages;
+        uint32_t BytesCopied; // Payload bytes serialized, plus those copied into the MQTT client's buffer.
+        uint32_t Allocations; // Heap allocations made building the payloads.
+    };
+
+    PublishCycleStats get_state_cycle_stats();
+    PublishCycleStats get_discovery_cycle_stats();
 } // namespace ehal::mqtt
\ No newline at end of file
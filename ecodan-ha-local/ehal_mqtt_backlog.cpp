@@ -0,0 +1,97 @@
+#include "ehal_diagnostics.h"
+#include "ehal_mqtt_backlog.h"
+#include "psram_alloc.h"
+
+#include <ctime>
+#include <mutex>
+#include <new>
+
+#define BACKLOG_PSRAM_SAMPLES 2880 // 24 hours of 30s updates, ~400KiB.
+#define BACKLOG_HEAP_SAMPLES 60 // 30 minutes, for boards without PSRAM.
+
+namespace ehal::mqtt::backlog
+{
+    std::mutex backlogLock;
+    Sample* ring = nullptr;
+    size_t ringCapacity = 0;
+    uint64_t readSeq = 0; // ring[readSeq % ringCapacity] is the oldest sample.
+    uint64_t writeSeq = 0; // ring[writeSeq % ringCapacity] is written next.
+    uint64_t overwrittenCount = 0;
+    bool allocationFailed = false; // Not retried, updates just aren't held during outages.
+
+    bool allocate_ring()
+    {
+        if (allocationFailed)
+            return false;
+
+        size_t capacity = psram::exists() ? BACKLOG_PSRAM_SAMPLES : BACKLOG_HEAP_SAMPLES;
+        try
+        {
+            ring = psram::allocator<Sample>().allocate(capacity);
+        }
+        catch (const std::bad_alloc&)
+        {
+            allocationFailed = true;
+            log_web(F("Unable to allocate MQTT backlog for %u samples, updates won't be held while MQTT is down"), static_cast<unsigned>(capacity));
+            return false;
+        }
+
+        ringCapacity = capacity;
+        return true;
+    }
+
+    void push(const hp::Status& status)
+    {
+        std::lock_guard<std::mutex> lock{backlogLock};
+
+        if (ring == nullptr && !allocate_ring())
+            return;
+
+        if (writeSeq - readSeq == ringCapacity)
+        {
+            ++readSeq;
+            ++overwrittenCount;
+        }
+
+        Sample& s = ring[writeSeq++ % ringCapacity];
+        s.Timestamp = time(nullptr);
+        s.Status = status;
+    }
+
+    bool peek(Sample& sample)
+    {
+        std::lock_guard<std::mutex> lock{backlogLock};
+
+        if (readSeq == writeSeq)
+            return false;
+
+        sample = ring[readSeq % ringCapacity];
+        return true;
+    }
+
+    void pop()
+    {
+        std::lock_guard<std::mutex> lock{backlogLock};
+
+        if (readSeq != writeSeq)
+            ++readSeq;
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock{backlogLock};
+        return writeSeq - readSeq;
+    }
+
+    size_t capacity()
+    {
+        std::lock_guard<std::mutex> lock{backlogLock};
+        return ringCapacity;
+    }
+
+    uint64_t overwritten_count()
+    {
+        std::lock_guard<std::mutex> lock{backlogLock};
+        return overwrittenCount;
+    }
+} // namespace ehal::mqtt::backlog
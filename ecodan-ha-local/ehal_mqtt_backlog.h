@@ -0,0 +1,26 @@
+#pragma once
+
+#include "ehal_hp.h"
+
+#include <cstdint>
+
+namespace ehal::mqtt::backlog
+{
+    // A heat pump status update which couldn't be published, held until MQTT reconnects.
+    struct Sample
+    {
+        int64_t Timestamp; // Unix time (s)
+        hp::Status Status;
+    };
+
+    // Appends a sample, overwriting the oldest once the backlog is full.
+    void push(const hp::Status& status);
+
+    // Copies the oldest sample without removing it, returns false if the backlog is empty.
+    bool peek(Sample& sample);
+    void pop();
+
+    size_t size();
+    size_t capacity();
+    uint64_t overwritten_count();
+} // namespace ehal::mqtt::backlog
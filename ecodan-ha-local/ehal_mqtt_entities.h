@@ -0,0 +1,250 @@
+#pragma once
+
+#include "ehal_hp.h"
+#include "ehal_hp_registers.h"
+#include "ehal_thirdparty.h"
+
+#include <iterator>
+
+namespace ehal::mqtt
+{
+#define ENTITY_FLAG_DIAGNOSTIC 0x01    // Diagnostic category, named without the unique id suffix and left out of backlog samples
+#define ENTITY_FLAG_DISABLED 0x02      // Disabled in HomeAssistant until the user enables it
+#define ENTITY_FLAG_TEMP_DEADBAND 0x04 // Changes within the MQTT temperature deadband aren't published
+
+    // HomeAssistant MQTT integration an entity is discovered as.
+    enum class Component : uint8_t
+    {
+        NONE, // Only subscribed to, for a command topic another entity's discovery refers to
+        SENSOR,
+        BINARY_SENSOR,
+        CLIMATE,
+        SWITCH,
+        NUMBER,
+        SELECT,
+        WATER_HEATER
+    };
+
+    inline constexpr const char* COMPONENT_NAMES[] = {"", "sensor", "binary_sensor", "climate", "switch", "number", "select", "water_heater"};
+
+    // Discovery fields describing an entity's value, nullptr fields are left out.
+    struct SensorClass
+    {
+        const char* Unit;
+        const char* DeviceClass;
+        const char* StateClass;
+        const char* Icon;
+    };
+
+    inline constexpr SensorClass NO_CLASS = {nullptr, nullptr, nullptr, nullptr};
+    inline constexpr SensorClass ENERGY = {"kWh", "energy", "total", "mdi:lightning-bolt"};
+    inline constexpr SensorClass LIVE_POWER = {"kW", "energy", nullptr, "mdi:lightning-bolt"};
+    inline constexpr SensorClass FREQUENCY = {"Hz", "frequency", nullptr, "mdi:fan"};
+    inline constexpr SensorClass FLOW_RATE = {"L/min", nullptr, nullptr, "mdi:pump"};
+    inline constexpr SensorClass TEMPERATURE = {"°C", "temperature", nullptr, nullptr};
+    inline constexpr SensorClass COP = {"COP", nullptr, "measurement", "mdi:heat-pump-outline"};
+    inline constexpr SensorClass CONNECTIVITY = {nullptr, "connectivity", nullptr, nullptr};
+    inline constexpr SensorClass WIFI_SIGNAL = {"dBm", "signal_strength", nullptr, "mdi:wifi"};
+    inline constexpr SensorClass BACKLOG = {"samples", nullptr, "measurement", "mdi:tray-full"};
+
+    struct Entity
+    {
+        const char* Name;
+        Component Kind;
+        SensorClass Class;
+        uint8_t Precision; // Decimal places of a Number state
+        uint8_t Flags;     // ENTITY_FLAG_*
+
+        // At most one state accessor is set. Scalar states go to the entity's state topic (or field of the
+        // single state topic document), Document states always go to the entity's own state topic.
+        float (*Number)(hp::Status& status);
+        bool (*Binary)(hp::Status& status);
+        String (*Text)(hp::Status& status);
+        void (*Document)(hp::Status& status, JsonObject json);
+
+        const char* StateOf; // Entity whose state a control shows
+        const char* CommandSuffix;
+        void (*OnCommand)(const String& payload);
+
+        // Adds the component specific discovery fields.
+        void (*Discover)(JsonObject json, const String& stateTopic, const String& commandTopic);
+
+        uint64_t SourceFields; // REGISTER_FIELDS a scalar state is read from, it's skipped in cycles where none changed
+    };
+
+    // A Number or Binary state accessor and the REGISTER_FIELDS it reads, states derived from anything
+    // else (or not from registers at all) are treated as reading every field.
+    template <typename T>
+    struct StateAccessor
+    {
+        constexpr StateAccessor(T (*read)(hp::Status&), uint64_t fields = hp::ALL_REGISTER_FIELDS)
+            : Read{read}, Fields{fields}
+        {
+        }
+
+        T (*Read)(hp::Status&);
+        uint64_t Fields;
+    };
+
+    template <auto Member>
+    constexpr uint64_t source_fields()
+    {
+        uint64_t fields = hp::register_field_mask<Member>();
+        return fields != 0 ? fields : hp::ALL_REGISTER_FIELDS;
+    }
+
+    template <auto Member>
+    float read_number(hp::Status& status)
+    {
+        return static_cast<float>(status.*Member);
+    }
+
+    template <auto Member>
+    inline constexpr StateAccessor<float> number_state{read_number<Member>, source_fields<Member>()};
+
+    template <auto Member>
+    bool read_binary(hp::Status& status)
+    {
+        return status.*Member;
+    }
+
+    template <auto Member>
+    inline constexpr StateAccessor<bool> binary_state{read_binary<Member>, source_fields<Member>()};
+
+    template <String (hp::Status::*Fn)()>
+    String text_state(hp::Status& status)
+    {
+        return (status.*Fn)();
+    }
+
+    template <auto Delivered, auto Consumed>
+    float read_cop(hp::Status& status)
+    {
+        return status.*Consumed > 0.0f ? status.*Delivered / status.*Consumed : 0.0f;
+    }
+
+    template <auto Delivered, auto Consumed>
+    inline constexpr StateAccessor<float> cop_state{read_cop<Delivered, Consumed>, source_fields<Delivered>() | source_fields<Consumed>()};
+
+    // Defined in ehal_mqtt.cpp.
+    void climate_z1_state(hp::Status& status, JsonObject json);
+    void climate_z2_state(hp::Status& status, JsonObject json);
+    bool hp_connection_state(hp::Status& status);
+    float wifi_signal_state(hp::Status& status);
+    String wifi_ssid_state(hp::Status& status);
+    String ip_address_state(hp::Status& status);
+    String mac_address_state(hp::Status& status);
+    float backlog_state(hp::Status& status);
+
+    void on_z1_temperature_set_command(const String& payload);
+    void on_z2_temperature_set_command(const String& payload);
+    void on_z1_flow_target_temperature_set_command(const String& payload);
+    void on_z2_flow_target_temperature_set_command(const String& payload);
+    void on_dhw_temperature_set_command(const String& payload);
+    void on_mode_set_command(const String& payload);
+    void on_dhw_mode_set_command(const String& payload);
+    void on_force_dhw_command(const String& payload);
+    void on_turn_on_off_command(const String& payload);
+
+    void discover_climate_z1(JsonObject json, const String& stateTopic, const String& commandTopic);
+    void discover_climate_z2(JsonObject json, const String& stateTopic, const String& commandTopic);
+    void discover_flow_target(JsonObject json, const String& stateTopic, const String& commandTopic);
+    void discover_force_dhw(JsonObject json, const String& stateTopic, const String& commandTopic);
+    void discover_power_switch(JsonObject json, const String& stateTopic, const String& commandTopic);
+    void discover_water_heater(JsonObject json, const String& stateTopic, const String& commandTopic);
+    void discover_sh_mode(JsonObject json, const String& stateTopic, const String& commandTopic);
+
+    constexpr Entity sensor(const char* name, StateAccessor<float> value, SensorClass sensorClass, uint8_t flags = 0, uint8_t precision = 2)
+    {
+        return Entity{name, Component::SENSOR, sensorClass, precision, flags, value.Read, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, value.Fields};
+    }
+
+    constexpr Entity temperature_sensor(const char* name, StateAccessor<float> value)
+    {
+        return sensor(name, value, TEMPERATURE, ENTITY_FLAG_TEMP_DEADBAND);
+    }
+
+    constexpr Entity binary_sensor(const char* name, StateAccessor<bool> value, SensorClass sensorClass = NO_CLASS, uint8_t flags = 0)
+    {
+        return Entity{name, Component::BINARY_SENSOR, sensorClass, 0, flags, nullptr, value.Read, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, value.Fields};
+    }
+
+    constexpr Entity text_sensor(const char* name, String (*value)(hp::Status&), SensorClass sensorClass = NO_CLASS, uint8_t flags = 0)
+    {
+        return Entity{name, Component::SENSOR, sensorClass, 0, flags, nullptr, nullptr, value, nullptr, nullptr, nullptr, nullptr, nullptr, hp::ALL_REGISTER_FIELDS};
+    }
+
+    constexpr Entity climate(const char* name, void (*state)(hp::Status&, JsonObject), void (*onCommand)(const String&),
+                             void (*discover)(JsonObject, const String&, const String&))
+    {
+        return Entity{name, Component::CLIMATE, {nullptr, nullptr, nullptr, "mdi:heat-pump-outline"}, 0, 0, nullptr, nullptr, nullptr, state, nullptr, "/temp_cmd", onCommand, discover, hp::ALL_REGISTER_FIELDS};
+    }
+
+    constexpr Entity control(const char* name, Component kind, const char* stateOf, SensorClass sensorClass, void (*onCommand)(const String&),
+                             void (*discover)(JsonObject, const String&, const String&))
+    {
+        return Entity{name, kind, sensorClass, 0, 0, nullptr, nullptr, nullptr, nullptr, stateOf, "/set", onCommand, discover, hp::ALL_REGISTER_FIELDS};
+    }
+
+    constexpr Entity command(const char* name, void (*onCommand)(const String&))
+    {
+        return Entity{name, Component::NONE, NO_CLASS, 0, 0, nullptr, nullptr, nullptr, nullptr, nullptr, "/set", onCommand, nullptr, hp::ALL_REGISTER_FIELDS};
+    }
+
+    // Every entity exposed to HomeAssistant, in discovery and publishing order.
+    inline constexpr Entity ENTITIES[] = {
+        climate("climate_control", climate_z1_state, on_z1_temperature_set_command, discover_climate_z1),
+        climate("climate_control_z2", climate_z2_state, on_z2_temperature_set_command, discover_climate_z2),
+        control("z1_flow_temp_target", Component::NUMBER, "z1_flow_temp_target", {"°C", "temperature", nullptr, "mdi:thermometer-water"},
+                on_z1_flow_target_temperature_set_command, discover_flow_target),
+        command("z2_flow_temp_target", on_z2_flow_target_temperature_set_command),
+        control("force_dhw", Component::SWITCH, "mode_dhw_forced", {nullptr, nullptr, nullptr, "mdi:toggle-switch-variant"}, on_force_dhw_command, discover_force_dhw),
+        control("turn_on_off_hp", Component::SWITCH, "mode_power", {nullptr, nullptr, nullptr, "mdi:power"}, on_turn_on_off_command, discover_power_switch),
+        control("dhw_water_heater", Component::WATER_HEATER, nullptr, NO_CLASS, on_dhw_temperature_set_command, discover_water_heater),
+        command("dhw_mode", on_dhw_mode_set_command),
+        control("sh_mode", Component::SELECT, "mode_heating_cooling", NO_CLASS, on_mode_set_command, discover_sh_mode),
+
+        binary_sensor("mode_defrost", binary_state<&hp::Status::DefrostActive>),
+        sensor("compressor_frequency", number_state<&hp::Status::CompressorFrequency>, FREQUENCY),
+        sensor("flow_rate", number_state<&hp::Status::FlowRate>, FLOW_RATE),
+        binary_sensor("mode_dhw_forced", binary_state<&hp::Status::DhwForcedActive>),
+        sensor("output_pwr", number_state<&hp::Status::OutputPower>, LIVE_POWER),
+        temperature_sensor("legionella_prevention_temp", number_state<&hp::Status::LegionellaPreventionSetPoint>),
+        temperature_sensor("dhw_temp_drop", number_state<&hp::Status::DhwTemperatureDrop>),
+        temperature_sensor("outside_temp", number_state<&hp::Status::OutsideTemperature>),
+        temperature_sensor("hp_feed_temp", number_state<&hp::Status::DhwFeedTemperature>),
+        temperature_sensor("hp_return_temp", number_state<&hp::Status::DhwReturnTemperature>),
+        temperature_sensor("boiler_flow_temp", number_state<&hp::Status::BoilerFlowTemperature>),
+        temperature_sensor("boiler_return_temp", number_state<&hp::Status::BoilerReturnTemperature>),
+        temperature_sensor("dhw_flow_temp_target", number_state<&hp::Status::DhwFlowTemperatureSetPoint>),
+        temperature_sensor("sh_flow_temp_target", number_state<&hp::Status::RadiatorFlowTemperatureSetPoint>),
+        text_sensor("mode_power", text_state<&hp::Status::power_as_string>),
+        text_sensor("mode_operation", text_state<&hp::Status::operation_as_string>),
+        text_sensor("mode_dhw", text_state<&hp::Status::dhw_mode_as_string>),
+        text_sensor("mode_heating_cooling", text_state<&hp::Status::hp_mode_as_string>),
+        sensor("heating_consumed", number_state<&hp::Status::EnergyConsumedHeating>, ENERGY),
+        sensor("heating_delivered", number_state<&hp::Status::EnergyDeliveredHeating>, ENERGY),
+        sensor("cooling_consumed", number_state<&hp::Status::EnergyConsumedCooling>, ENERGY),
+        sensor("cooling_delivered", number_state<&hp::Status::EnergyDeliveredCooling>, ENERGY),
+        sensor("dhw_consumed", number_state<&hp::Status::EnergyConsumedDhw>, ENERGY),
+        sensor("dhw_delivered", number_state<&hp::Status::EnergyDeliveredDhw>, ENERGY),
+        temperature_sensor("z1_room_temp", number_state<&hp::Status::Zone1RoomTemperature>),
+        temperature_sensor("z1_flow_temp_target", number_state<&hp::Status::Zone1FlowTemperatureSetPoint>),
+        temperature_sensor("z1_room_temp_target", number_state<&hp::Status::Zone1SetTemperature>),
+        temperature_sensor("z2_room_temp", number_state<&hp::Status::Zone2RoomTemperature>),
+        temperature_sensor("z2_flow_temp_target", number_state<&hp::Status::Zone2FlowTemperatureSetPoint>),
+        temperature_sensor("z2_room_temp_target", number_state<&hp::Status::Zone2SetTemperature>),
+        temperature_sensor("dhw_temp", number_state<&hp::Status::DhwTemperature>),
+        sensor("dhw_cop", cop_state<&hp::Status::EnergyDeliveredDhw, &hp::Status::EnergyConsumedDhw>, COP),
+        sensor("sh_cop", cop_state<&hp::Status::EnergyDeliveredHeating, &hp::Status::EnergyConsumedHeating>, COP),
+        sensor("cool_cop", cop_state<&hp::Status::EnergyDeliveredCooling, &hp::Status::EnergyConsumedCooling>, COP),
+
+        binary_sensor("Heat pump connection state", hp_connection_state, CONNECTIVITY, ENTITY_FLAG_DIAGNOSTIC),
+        sensor("Wifi signal", wifi_signal_state, WIFI_SIGNAL, ENTITY_FLAG_DIAGNOSTIC, 0),
+        text_sensor("Wifi SSID", wifi_ssid_state, {nullptr, nullptr, nullptr, "mdi:eye"}, ENTITY_FLAG_DIAGNOSTIC | ENTITY_FLAG_DISABLED),
+        text_sensor("IP address", ip_address_state, {nullptr, nullptr, nullptr, "mdi:ip"}, ENTITY_FLAG_DIAGNOSTIC | ENTITY_FLAG_DISABLED),
+        text_sensor("MAC address", mac_address_state, {nullptr, nullptr, nullptr, "mdi:eye"}, ENTITY_FLAG_DIAGNOSTIC | ENTITY_FLAG_DISABLED),
+        sensor("MQTT backlog", backlog_state, BACKLOG, ENTITY_FLAG_DIAGNOSTIC, 0)};
+
+    inline constexpr size_t ENTITY_COUNT = std::size(ENTITIES);
+} // namespace ehal::mqtt
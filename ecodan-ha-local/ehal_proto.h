@@ -123,20 +123,6 @@ namespace ehal::hp
             return *this;
         }
 
-        void debug_dump_packet()
-        {
-            if (!valid_)
-                return;
-
-            log_web(F("%s { .Hdr { %x, %x, %x, %x, %x } .Payload { %x, %x, %x, %x, %x, %x, %x, %x, %x, %x, %x, %x, %x, %x, %x, %x } .Chk { %x } }"),
-                    cmd_ ? "CMD" : "RES",
-                    buffer_[0], buffer_[1], buffer_[2], buffer_[3], buffer_[4],
-                    buffer_[5], buffer_[6], buffer_[7], buffer_[8], buffer_[9],
-                    buffer_[10], buffer_[11], buffer_[12], buffer_[13], buffer_[14],
-                    buffer_[15], buffer_[16], buffer_[17], buffer_[18], buffer_[19], buffer_[20],
-                    buffer_[21]);
-        }
-
         bool verify_header()
         {
             if (buffer_[0] != HEADER_MAGIC_A)
@@ -167,6 +153,24 @@ namespace ehal::hp
             return static_cast<T>(buffer_[HEADER_SIZE]);
         }
 
+        // True if this message is the response to the given command.
+        bool is_response_to(const Message& cmd) const
+        {
+            switch (cmd.type())
+            {
+            case MsgType::GET_CMD:
+                return type() == MsgType::GET_RES && payload_type<GetType>() == cmd.payload_type<GetType>();
+            case MsgType::SET_CMD:
+                return type() == MsgType::SET_RES; // SET_RES doesn't reliably echo the SetType.
+            case MsgType::CONNECT_CMD:
+                return type() == MsgType::CONNECT_RES;
+            case MsgType::EXT_CONNECT_CMD:
+                return type() == MsgType::EXT_CONNECT_RES;
+            default:
+                return false;
+            }
+        }
+
         uint8_t* buffer()
         {
             return std::addressof(buffer_[0]);
@@ -309,4 +313,100 @@ namespace ehal::hp
         uint8_t buffer_[TOTAL_MSG_SIZE];
         uint8_t writeOffset_ = 0;
     };
+
+    // Incremental frame parser, fed one byte at a time as data arrives on the serial port.
+    // When a partial frame turns out to be invalid (bad header or checksum), only its first byte
+    // is discarded and the remainder is re-scanned for the next header, so a corrupt byte costs
+    // at most the frame it landed in.
+    class FrameParser
+    {
+      public:
+        // Returns true once a complete, checksum-verified frame has been written to msg.
+        bool consume(uint8_t byte, Message& msg)
+        {
+            buffer_[length_++] = byte;
+
+            while (length_ > 0)
+            {
+                if (!is_plausible_prefix())
+                {
+                    discard_first_byte();
+                    continue;
+                }
+
+                if (length_ < HEADER_SIZE || length_ < HEADER_SIZE + buffer_[PAYLOAD_SIZE_OFFSET] + CHECKSUM_SIZE)
+                    return false;
+
+                // Decoders read fixed payload offsets, so bytes past a short frame's payload must not
+                // carry over from whichever frame last used msg.
+                msg.write_header(reinterpret_cast<const char*>(buffer_), HEADER_SIZE);
+                memset(msg.payload(), 0, PAYLOAD_SIZE + CHECKSUM_SIZE);
+                memcpy(msg.payload(), buffer_ + HEADER_SIZE, msg.payload_size() + CHECKSUM_SIZE);
+                msg.increment_write_offset(msg.payload_size()); // Don't count checksum byte.
+
+                if (!msg.verify_checksum())
+                {
+                    ++checksumErrors_;
+                    discard_first_byte();
+                    continue;
+                }
+
+                length_ = 0;
+                return true;
+            }
+
+            return false;
+        }
+
+        void reset()
+        {
+            droppedBytes_ += length_;
+            length_ = 0;
+        }
+
+        uint64_t dropped_bytes() const
+        {
+            return droppedBytes_;
+        }
+
+        uint64_t checksum_errors() const
+        {
+            return checksumErrors_;
+        }
+
+      private:
+        bool is_plausible_prefix() const
+        {
+            if (buffer_[0] != HEADER_MAGIC_A)
+                return false;
+
+            if (length_ > 2 && buffer_[2] != HEADER_MAGIC_B)
+                return false;
+
+            if (length_ > 3 && buffer_[3] != HEADER_MAGIC_C)
+                return false;
+
+            if (length_ > PAYLOAD_SIZE_OFFSET && buffer_[PAYLOAD_SIZE_OFFSET] > PAYLOAD_SIZE)
+                return false;
+
+            return true;
+        }
+
+        void discard_first_byte()
+        {
+            // Skip straight to the next header magic byte, if there is one.
+            size_t next = 1;
+            while (next < length_ && buffer_[next] != HEADER_MAGIC_A)
+                ++next;
+
+            memmove(buffer_, buffer_ + next, length_ - next);
+            length_ -= next;
+            droppedBytes_ += next;
+        }
+
+        uint8_t buffer_[TOTAL_MSG_SIZE];
+        uint8_t length_ = 0;
+        uint64_t droppedBytes_ = 0;
+        uint64_t checksumErrors_ = 0;
+    };
 } // namespace ehal::hp
\ No newline at end of file
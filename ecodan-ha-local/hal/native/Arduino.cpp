@@ -0,0 +1,730 @@
+#include "Arduino.h"
+
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const auto startTime = std::chrono::steady_clock::now();
+
+    std::mutex interruptLock;
+    std::map<uint8_t, void (*)()> interruptHandlers;
+
+    std::vector<char*> restartArgs;
+
+    std::string integer_to_string(unsigned long long value, bool negative, unsigned char base)
+    {
+        if (base < 2 || base > 36)
+            base = 10;
+
+        std::string out;
+        do
+        {
+            unsigned digit = value % base;
+            out.push_back(static_cast<char>(digit < 10 ? '0' + digit : 'a' + digit - 10));
+            value /= base;
+        } while (value != 0);
+
+        if (negative)
+            out.push_back('-');
+
+        std::reverse(out.begin(), out.end());
+        return out;
+    }
+
+    std::string signed_to_string(long long value, unsigned char base)
+    {
+        if (base == 10 && value < 0)
+            return integer_to_string(0ULL - static_cast<unsigned long long>(value), true, base);
+
+        return integer_to_string(static_cast<unsigned long long>(value), false, base);
+    }
+
+    std::string float_to_string(double value, unsigned int decimalPlaces)
+    {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%.*f", static_cast<int>(decimalPlaces), value);
+        return buffer;
+    }
+} // namespace
+
+unsigned long millis()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+unsigned long micros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void delay(uint32_t ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield()
+{
+    std::this_thread::yield();
+}
+
+long random(long max)
+{
+    return random(0, max);
+}
+
+long random(long min, long max)
+{
+    static std::mt19937 rng{std::random_device{}()};
+
+    if (max <= min)
+        return min;
+
+    std::uniform_int_distribution<long> dist{min, max - 1};
+    return dist(rng);
+}
+
+void pinMode(uint8_t, uint8_t)
+{
+}
+
+void digitalWrite(uint8_t, uint8_t)
+{
+}
+
+int digitalRead(uint8_t)
+{
+    return LOW;
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(), int)
+{
+    std::lock_guard<std::mutex> lock{interruptLock};
+    interruptHandlers[pin] = isr;
+}
+
+void detachInterrupt(uint8_t pin)
+{
+    std::lock_guard<std::mutex> lock{interruptLock};
+    interruptHandlers.erase(pin);
+}
+
+void native_raise_interrupt(uint8_t pin)
+{
+    void (*isr)() = nullptr;
+    {
+        std::lock_guard<std::mutex> lock{interruptLock};
+        auto it = interruptHandlers.find(pin);
+        if (it != std::end(interruptHandlers))
+            isr = it->second;
+    }
+
+    if (isr)
+        isr();
+}
+
+String::String(const char* cstr)
+{
+    if (cstr)
+        buffer_ = cstr;
+}
+
+String::String(const char* cstr, unsigned int length)
+{
+    if (cstr)
+        buffer_.assign(cstr, length);
+}
+
+String::String(const __FlashStringHelper* str)
+    : String(reinterpret_cast<const char*>(str))
+{
+}
+
+String::String(const std::string& str)
+    : buffer_(str)
+{
+}
+
+String::String(char c)
+    : buffer_(1, c)
+{
+}
+
+String::String(unsigned char value, unsigned char base)
+    : buffer_(integer_to_string(value, false, base))
+{
+}
+
+String::String(int value, unsigned char base)
+    : buffer_(signed_to_string(value, base))
+{
+}
+
+String::String(unsigned int value, unsigned char base)
+    : buffer_(integer_to_string(value, false, base))
+{
+}
+
+String::String(long value, unsigned char base)
+    : buffer_(signed_to_string(value, base))
+{
+}
+
+String::String(unsigned long value, unsigned char base)
+    : buffer_(integer_to_string(value, false, base))
+{
+}
+
+String::String(long long value, unsigned char base)
+    : buffer_(signed_to_string(value, base))
+{
+}
+
+String::String(unsigned long long value, unsigned char base)
+    : buffer_(integer_to_string(value, false, base))
+{
+}
+
+String::String(float value, unsigned int decimalPlaces)
+    : buffer_(float_to_string(value, decimalPlaces))
+{
+}
+
+String::String(double value, unsigned int decimalPlaces)
+    : buffer_(float_to_string(value, decimalPlaces))
+{
+}
+
+String& String::operator=(const char* cstr)
+{
+    if (cstr)
+        buffer_ = cstr;
+    else
+        buffer_.clear();
+
+    return *this;
+}
+
+String& String::operator=(const __FlashStringHelper* str)
+{
+    return *this = reinterpret_cast<const char*>(str);
+}
+
+bool String::reserve(unsigned int size)
+{
+    buffer_.reserve(size);
+    return true;
+}
+
+void String::clear()
+{
+    buffer_.clear();
+}
+
+unsigned int String::length() const
+{
+    return buffer_.length();
+}
+
+bool String::isEmpty() const
+{
+    return buffer_.empty();
+}
+
+const char* String::c_str() const
+{
+    return buffer_.c_str();
+}
+
+char* String::begin()
+{
+    return buffer_.data();
+}
+
+char* String::end()
+{
+    return buffer_.data() + buffer_.length();
+}
+
+const char* String::begin() const
+{
+    return buffer_.data();
+}
+
+const char* String::end() const
+{
+    return buffer_.data() + buffer_.length();
+}
+
+bool String::concat(const String& str)
+{
+    buffer_ += str.buffer_;
+    return true;
+}
+
+bool String::concat(const char* cstr)
+{
+    if (!cstr)
+        return false;
+
+    buffer_ += cstr;
+    return true;
+}
+
+bool String::concat(const char* cstr, unsigned int length)
+{
+    if (!cstr)
+        return false;
+
+    buffer_.append(cstr, length);
+    return true;
+}
+
+bool String::concat(const __FlashStringHelper* str)
+{
+    return concat(reinterpret_cast<const char*>(str));
+}
+
+bool String::concat(char c)
+{
+    buffer_ += c;
+    return true;
+}
+
+bool String::concat(int value)
+{
+    return concat(String(value));
+}
+
+bool String::concat(unsigned int value)
+{
+    return concat(String(value));
+}
+
+bool String::concat(long value)
+{
+    return concat(String(value));
+}
+
+bool String::concat(unsigned long value)
+{
+    return concat(String(value));
+}
+
+bool String::concat(float value)
+{
+    return concat(String(value));
+}
+
+bool String::concat(double value)
+{
+    return concat(String(value));
+}
+
+int String::compareTo(const String& other) const
+{
+    return buffer_.compare(other.buffer_);
+}
+
+bool String::equals(const String& other) const
+{
+    return buffer_ == other.buffer_;
+}
+
+bool String::equals(const char* cstr) const
+{
+    return cstr ? buffer_ == cstr : buffer_.empty();
+}
+
+bool String::equalsIgnoreCase(const String& other) const
+{
+    return buffer_.size() == other.buffer_.size() &&
+           std::equal(buffer_.begin(), buffer_.end(), other.buffer_.begin(), [](char a, char b)
+    {
+        return tolower(a) == tolower(b);
+    });
+}
+
+bool String::startsWith(const String& prefix) const
+{
+    return buffer_.compare(0, prefix.buffer_.size(), prefix.buffer_) == 0;
+}
+
+bool String::endsWith(const String& suffix) const
+{
+    return buffer_.size() >= suffix.buffer_.size() &&
+           buffer_.compare(buffer_.size() - suffix.buffer_.size(), suffix.buffer_.size(), suffix.buffer_) == 0;
+}
+
+bool String::operator==(const String& rhs) const
+{
+    return equals(rhs);
+}
+
+bool String::operator==(const char* rhs) const
+{
+    return equals(rhs);
+}
+
+bool String::operator!=(const String& rhs) const
+{
+    return !equals(rhs);
+}
+
+bool String::operator!=(const char* rhs) const
+{
+    return !equals(rhs);
+}
+
+bool String::operator<(const String& rhs) const
+{
+    return buffer_ < rhs.buffer_;
+}
+
+char String::charAt(unsigned int index) const
+{
+    return index < buffer_.size() ? buffer_[index] : 0;
+}
+
+void String::setCharAt(unsigned int index, char c)
+{
+    if (index < buffer_.size())
+        buffer_[index] = c;
+}
+
+char String::operator[](unsigned int index) const
+{
+    return charAt(index);
+}
+
+char& String::operator[](unsigned int index)
+{
+    return buffer_[index];
+}
+
+int String::indexOf(char c, unsigned int fromIndex) const
+{
+    size_t pos = buffer_.find(c, fromIndex);
+    return pos == std::string::npos ? -1 : static_cast<int>(pos);
+}
+
+int String::indexOf(const String& str, unsigned int fromIndex) const
+{
+    size_t pos = buffer_.find(str.buffer_, fromIndex);
+    return pos == std::string::npos ? -1 : static_cast<int>(pos);
+}
+
+int String::lastIndexOf(char c) const
+{
+    size_t pos = buffer_.rfind(c);
+    return pos == std::string::npos ? -1 : static_cast<int>(pos);
+}
+
+int String::lastIndexOf(const String& str) const
+{
+    size_t pos = buffer_.rfind(str.buffer_);
+    return pos == std::string::npos ? -1 : static_cast<int>(pos);
+}
+
+String String::substring(unsigned int beginIndex) const
+{
+    return substring(beginIndex, buffer_.size());
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const
+{
+    if (beginIndex > endIndex)
+        std::swap(beginIndex, endIndex);
+
+    if (beginIndex >= buffer_.size())
+        return String();
+
+    endIndex = std::min<unsigned int>(endIndex, buffer_.size());
+    return String(buffer_.substr(beginIndex, endIndex - beginIndex));
+}
+
+void String::replace(char find, char replace)
+{
+    std::replace(buffer_.begin(), buffer_.end(), find, replace);
+}
+
+void String::replace(const String& find, const String& replace)
+{
+    if (find.buffer_.empty())
+        return;
+
+    size_t pos = 0;
+    while ((pos = buffer_.find(find.buffer_, pos)) != std::string::npos)
+    {
+        buffer_.replace(pos, find.buffer_.size(), replace.buffer_);
+        pos += replace.buffer_.size();
+    }
+}
+
+void String::remove(unsigned int index)
+{
+    if (index < buffer_.size())
+        buffer_.erase(index);
+}
+
+void String::remove(unsigned int index, unsigned int count)
+{
+    if (index < buffer_.size())
+        buffer_.erase(index, count);
+}
+
+void String::toLowerCase()
+{
+    std::transform(buffer_.begin(), buffer_.end(), buffer_.begin(), [](char c)
+    {
+        return static_cast<char>(tolower(c));
+    });
+}
+
+void String::toUpperCase()
+{
+    std::transform(buffer_.begin(), buffer_.end(), buffer_.begin(), [](char c)
+    {
+        return static_cast<char>(toupper(c));
+    });
+}
+
+void String::trim()
+{
+    size_t first = buffer_.find_first_not_of(" \t\r\n\f\v");
+    if (first == std::string::npos)
+    {
+        buffer_.clear();
+        return;
+    }
+
+    size_t last = buffer_.find_last_not_of(" \t\r\n\f\v");
+    buffer_ = buffer_.substr(first, last - first + 1);
+}
+
+long String::toInt() const
+{
+    return strtol(buffer_.c_str(), nullptr, 10);
+}
+
+float String::toFloat() const
+{
+    return strtof(buffer_.c_str(), nullptr);
+}
+
+double String::toDouble() const
+{
+    return strtod(buffer_.c_str(), nullptr);
+}
+
+String operator+(const String& lhs, const String& rhs)
+{
+    String out{lhs};
+    out.concat(rhs);
+    return out;
+}
+
+String operator+(const String& lhs, const char* rhs)
+{
+    String out{lhs};
+    out.concat(rhs);
+    return out;
+}
+
+String operator+(const char* lhs, const String& rhs)
+{
+    String out{lhs};
+    out.concat(rhs);
+    return out;
+}
+
+String operator+(const String& lhs, const __FlashStringHelper* rhs)
+{
+    String out{lhs};
+    out.concat(rhs);
+    return out;
+}
+
+String operator+(const String& lhs, char rhs)
+{
+    String out{lhs};
+    out.concat(rhs);
+    return out;
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+    size_t written = 0;
+    while (written < size && write(buffer[written]) == 1)
+        ++written;
+
+    return written;
+}
+
+size_t Print::write(const char* str)
+{
+    return str ? write(reinterpret_cast<const uint8_t*>(str), strlen(str)) : 0;
+}
+
+size_t Print::print(const char* str)
+{
+    return write(str);
+}
+
+size_t Print::print(const String& str)
+{
+    return write(reinterpret_cast<const uint8_t*>(str.c_str()), str.length());
+}
+
+size_t Print::println(const char* str)
+{
+    return print(str) + print("\r\n");
+}
+
+size_t Print::println(const String& str)
+{
+    return print(str) + print("\r\n");
+}
+
+int Print::availableForWrite()
+{
+    return 0;
+}
+
+void Print::flush()
+{
+}
+
+void Stream::setTimeout(unsigned long timeout)
+{
+    timeout_ = timeout;
+}
+
+unsigned long Stream::getTimeout() const
+{
+    return timeout_;
+}
+
+int Stream::timedRead()
+{
+    unsigned long start = millis();
+    do
+    {
+        int c = read();
+        if (c >= 0)
+            return c;
+
+        delay(1);
+    } while (millis() - start < timeout_);
+
+    return -1;
+}
+
+size_t Stream::readBytes(char* buffer, size_t length)
+{
+    size_t count = 0;
+    while (count < length)
+    {
+        int c = timedRead();
+        if (c < 0)
+            break;
+
+        buffer[count++] = static_cast<char>(c);
+    }
+
+    return count;
+}
+
+size_t Stream::readBytes(uint8_t* buffer, size_t length)
+{
+    return readBytes(reinterpret_cast<char*>(buffer), length);
+}
+
+String Stream::readString()
+{
+    String out;
+    int c;
+    while ((c = timedRead()) >= 0)
+        out.concat(static_cast<char>(c));
+
+    return out;
+}
+
+EspClass ESP;
+
+uint64_t EspClass::getEfuseMac()
+{
+    return static_cast<uint64_t>(gethostid()) & 0xFFFFFFFFFFFFULL;
+}
+
+uint8_t EspClass::getChipCores()
+{
+    return static_cast<uint8_t>(std::thread::hardware_concurrency());
+}
+
+uint32_t EspClass::getCpuFreqMHz()
+{
+    return 0;
+}
+
+uint32_t EspClass::getFreeHeap()
+{
+    return 0;
+}
+
+uint32_t EspClass::getHeapSize()
+{
+    return 0;
+}
+
+uint32_t EspClass::getMinFreeHeap()
+{
+    return 0;
+}
+
+uint32_t EspClass::getFreePsram()
+{
+    return 0;
+}
+
+uint32_t EspClass::getPsramSize()
+{
+    return 0;
+}
+
+esp_reset_reason_t esp_reset_reason()
+{
+    return getenv("EHAL_RESTARTED") ? ESP_RST_SW : ESP_RST_POWERON;
+}
+
+void configTzTime(const char* tz, const char*, const char*, const char*)
+{
+    setenv("TZ", tz, 1);
+    tzset();
+}
+
+void EspClass::restart()
+{
+    fflush(nullptr);
+    setenv("EHAL_RESTARTED", "1", 1);
+
+    if (!restartArgs.empty())
+        execv("/proc/self/exe", restartArgs.data());
+
+    exit(0);
+}
+
+void native_set_restart_args(int argc, char** argv)
+{
+    restartArgs.assign(argv, argv + argc);
+    restartArgs.push_back(nullptr);
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+/*
+ * Linux stand-in for the subset of the Arduino-ESP32 core used by ecodan-ha-local.
+ * Only compiled by the "native" PlatformIO environment.
+ */
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// Program memory is ordinary memory on the host.
+#define PROGMEM
+#define IRAM_ATTR
+#define PGM_P const char*
+#define PSTR(s) (s)
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+#define FPSTR(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+#define pgm_read_byte(addr) (*reinterpret_cast<const uint8_t*>(addr))
+#define pgm_read_word(addr) (*reinterpret_cast<const uint16_t*>(addr))
+#define pgm_read_dword(addr) (*reinterpret_cast<const uint32_t*>(addr))
+#define pgm_read_ptr(addr) (*reinterpret_cast<void* const*>(addr))
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define memcmp_P memcmp
+#define memcpy_P memcpy
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+
+class __FlashStringHelper;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#ifndef LED_BUILTIN
+#define LED_BUILTIN 15
+#endif
+
+#define digitalPinToInterrupt(p) (p)
+
+#define highByte(w) ((uint8_t)((w) >> 8))
+#define lowByte(w) ((uint8_t)((w)&0xff))
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void yield();
+long random(long max);
+long random(long min, long max);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode);
+void detachInterrupt(uint8_t pin);
+
+// Invokes the handler registered with attachInterrupt for the given pin (the native serial port uses
+// this to raise "RX pin" interrupts when bytes arrive).
+void native_raise_interrupt(uint8_t pin);
+
+class String
+{
+  public:
+    String() = default;
+    String(const char* cstr);
+    String(const char* cstr, unsigned int length);
+    String(const __FlashStringHelper* str);
+    String(const std::string& str);
+    String(const String& other) = default;
+    String(String&& other) = default;
+    explicit String(char c);
+    explicit String(unsigned char value, unsigned char base = 10);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(long long value, unsigned char base = 10);
+    explicit String(unsigned long long value, unsigned char base = 10);
+    explicit String(float value, unsigned int decimalPlaces = 2);
+    explicit String(double value, unsigned int decimalPlaces = 2);
+
+    String& operator=(const String& other) = default;
+    String& operator=(String&& other) = default;
+    String& operator=(const char* cstr);
+    String& operator=(const __FlashStringHelper* str);
+
+    bool reserve(unsigned int size);
+    void clear();
+    unsigned int length() const;
+    bool isEmpty() const;
+    const char* c_str() const;
+    char* begin();
+    char* end();
+    const char* begin() const;
+    const char* end() const;
+
+    bool concat(const String& str);
+    bool concat(const char* cstr);
+    bool concat(const char* cstr, unsigned int length);
+    bool concat(const __FlashStringHelper* str);
+    bool concat(char c);
+    bool concat(int value);
+    bool concat(unsigned int value);
+    bool concat(long value);
+    bool concat(unsigned long value);
+    bool concat(float value);
+    bool concat(double value);
+
+    template <typename T>
+    String& operator+=(const T& rhs)
+    {
+        concat(rhs);
+        return *this;
+    }
+
+    int compareTo(const String& other) const;
+    bool equals(const String& other) const;
+    bool equals(const char* cstr) const;
+    bool equalsIgnoreCase(const String& other) const;
+    bool startsWith(const String& prefix) const;
+    bool endsWith(const String& suffix) const;
+
+    bool operator==(const String& rhs) const;
+    bool operator==(const char* rhs) const;
+    bool operator!=(const String& rhs) const;
+    bool operator!=(const char* rhs) const;
+    bool operator<(const String& rhs) const;
+
+    char charAt(unsigned int index) const;
+    void setCharAt(unsigned int index, char c);
+    char operator[](unsigned int index) const;
+    char& operator[](unsigned int index);
+
+    int indexOf(char c, unsigned int fromIndex = 0) const;
+    int indexOf(const String& str, unsigned int fromIndex = 0) const;
+    int lastIndexOf(char c) const;
+    int lastIndexOf(const String& str) const;
+    String substring(unsigned int beginIndex) const;
+    String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+    void replace(char find, char replace);
+    void replace(const String& find, const String& replace);
+    void remove(unsigned int index);
+    void remove(unsigned int index, unsigned int count);
+    void toLowerCase();
+    void toUpperCase();
+    void trim();
+
+    long toInt() const;
+    float toFloat() const;
+    double toDouble() const;
+
+  private:
+    std::string buffer_;
+};
+
+String operator+(const String& lhs, const String& rhs);
+String operator+(const String& lhs, const char* rhs);
+String operator+(const char* lhs, const String& rhs);
+String operator+(const String& lhs, const __FlashStringHelper* rhs);
+String operator+(const String& lhs, char rhs);
+
+class Print
+{
+  public:
+    virtual ~Print() = default;
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* str);
+    size_t print(const char* str);
+    size_t print(const String& str);
+    size_t println(const char* str = "");
+    size_t println(const String& str);
+    virtual int availableForWrite();
+    virtual void flush();
+};
+
+class Stream : public Print
+{
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long timeout);
+    unsigned long getTimeout() const;
+
+    virtual size_t readBytes(char* buffer, size_t length);
+    size_t readBytes(uint8_t* buffer, size_t length);
+    String readString();
+
+  protected:
+    int timedRead();
+
+    unsigned long timeout_ = 1000;
+};
+
+class EspClass
+{
+  public:
+    uint64_t getEfuseMac();
+    uint8_t getChipCores();
+    uint32_t getCpuFreqMHz();
+    uint32_t getFreeHeap();
+    uint32_t getHeapSize();
+    uint32_t getMinFreeHeap();
+    uint32_t getFreePsram();
+    uint32_t getPsramSize();
+    [[noreturn]] void restart();
+};
+
+extern EspClass ESP;
+
+typedef enum
+{
+    ESP_RST_UNKNOWN,
+    ESP_RST_POWERON,
+    ESP_RST_EXT,
+    ESP_RST_SW,
+    ESP_RST_PANIC,
+    ESP_RST_INT_WDT,
+    ESP_RST_TASK_WDT,
+    ESP_RST_WDT,
+    ESP_RST_DEEPSLEEP,
+    ESP_RST_BROWNOUT,
+    ESP_RST_SDIO,
+} esp_reset_reason_t;
+
+// A process start is reported as a power-on, unless it was re-executed by ESP.restart().
+esp_reset_reason_t esp_reset_reason();
+
+// The host clock is already NTP-synchronised, so this only applies the timezone.
+void configTzTime(const char* tz, const char* server1, const char* server2 = nullptr, const char* server3 = nullptr);
+
+// Records argv so that ESP.restart() can re-execute the process.
+void native_set_restart_args(int argc, char** argv);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "IPAddress.h"
+
+// The captive portal DNS server is not needed on the host, requests are served by the system resolver.
+class DNSServer
+{
+  public:
+    bool start(uint16_t port, const String& domainName, const IPAddress& resolvedIP)
+    {
+        return true;
+    }
+
+    void processNextRequest()
+    {
+    }
+
+    void stop()
+    {
+    }
+};
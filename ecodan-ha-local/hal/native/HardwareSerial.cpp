@@ -0,0 +1,332 @@
+#include "HardwareSerial.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#define SERIAL_DEVICE_DEFAULT "/tmp/ttyCN105"
+#define SERIAL_RX_BUFFER_DEFAULT 256U
+#define SERIAL_TX_BUFFER_SIZE 4096
+#define SERIAL_BITS_PER_SYMBOL 11 // 8E1 with a start bit
+
+HardwareSerial Serial1(1);
+
+struct HardwareSerial::Impl
+{
+    std::mutex lock;
+    std::deque<uint8_t> rxBuffer;
+    size_t rxBufferSize = SERIAL_RX_BUFFER_DEFAULT;
+    std::thread rxThread;
+    std::atomic<bool> running{false};
+    int fd = -1;
+    int8_t rxPin = -1;
+    unsigned long baud = 0;
+    OnReceiveCb onReceive;
+    bool onlyOnTimeout = false;
+    uint8_t rxTimeoutSymbols = 2;
+    uint8_t rxFifoFull = 1;
+};
+
+namespace
+{
+    speed_t to_termios_speed(unsigned long baud)
+    {
+        switch (baud)
+        {
+        case 1200:
+            return B1200;
+        case 2400:
+            return B2400;
+        case 4800:
+            return B4800;
+        case 9600:
+            return B9600;
+        case 19200:
+            return B19200;
+        case 38400:
+            return B38400;
+        case 57600:
+            return B57600;
+        default:
+            return B115200;
+        }
+    }
+} // namespace
+
+HardwareSerial::Impl& HardwareSerial::impl() const
+{
+    static Impl ports[3];
+    return ports[uartNum_ % 3];
+}
+
+void HardwareSerial::begin(unsigned long baud, uint32_t config, int8_t rxPin, int8_t txPin)
+{
+    end();
+
+    Impl& port = impl();
+
+    const char* device = getenv("EHAL_SERIAL_DEVICE");
+    if (!device)
+        device = SERIAL_DEVICE_DEFAULT;
+
+    port.fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (port.fd < 0)
+    {
+        fprintf(stderr, "Failed to open serial device '%s': %s\n", device, strerror(errno));
+        return;
+    }
+
+    termios tio = {};
+    if (tcgetattr(port.fd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, to_termios_speed(baud));
+        cfsetospeed(&tio, to_termios_speed(baud));
+        tio.c_cflag |= CLOCAL | CREAD;
+
+        if (config == SERIAL_8E1)
+            tio.c_cflag |= PARENB;
+
+        tcsetattr(port.fd, TCSANOW, &tio);
+    }
+
+    port.rxPin = rxPin;
+    port.baud = baud;
+    port.running = true;
+    port.rxThread = std::thread([&port]()
+    {
+        uint8_t buffer[64];
+        size_t pendingEvent = 0;
+
+        auto raise_receive_event = [&port]()
+        {
+            OnReceiveCb callback;
+            {
+                std::lock_guard<std::mutex> lock{port.lock};
+                callback = port.onReceive;
+            }
+
+            if (callback)
+                callback();
+        };
+
+        while (port.running)
+        {
+            // While bytes are waiting to be reported to onReceive, poll for the configured idle gap.
+            int timeoutMs = 100;
+            if (pendingEvent > 0)
+                timeoutMs = std::max<int>(1, port.rxTimeoutSymbols * SERIAL_BITS_PER_SYMBOL * 1000 / port.baud);
+
+            pollfd pfd = {port.fd, POLLIN, 0};
+            if (poll(&pfd, 1, timeoutMs) <= 0)
+            {
+                if (pendingEvent > 0)
+                    raise_receive_event();
+
+                pendingEvent = 0;
+                continue;
+            }
+
+            ssize_t count = ::read(port.fd, buffer, sizeof(buffer));
+            if (count <= 0)
+                continue;
+
+            {
+                std::lock_guard<std::mutex> lock{port.lock};
+                for (ssize_t i = 0; i < count; ++i)
+                {
+                    // Match the UART driver, which drops incoming data once its ring buffer is full.
+                    if (port.rxBuffer.size() < port.rxBufferSize)
+                        port.rxBuffer.push_back(buffer[i]);
+                }
+            }
+
+            if (port.rxPin >= 0)
+                native_raise_interrupt(port.rxPin);
+
+            pendingEvent += count;
+            if (!port.onlyOnTimeout && pendingEvent >= port.rxFifoFull)
+            {
+                raise_receive_event();
+                pendingEvent = 0;
+            }
+        }
+    });
+}
+
+void HardwareSerial::end()
+{
+    Impl& port = impl();
+
+    port.running = false;
+    if (port.rxThread.joinable())
+        port.rxThread.join();
+
+    if (port.fd >= 0)
+    {
+        close(port.fd);
+        port.fd = -1;
+    }
+
+    std::lock_guard<std::mutex> lock{port.lock};
+    port.rxBuffer.clear();
+}
+
+int HardwareSerial::available()
+{
+    Impl& port = impl();
+    std::lock_guard<std::mutex> lock{port.lock};
+    return port.rxBuffer.size();
+}
+
+int HardwareSerial::availableForWrite()
+{
+    return impl().fd >= 0 ? SERIAL_TX_BUFFER_SIZE : 0;
+}
+
+int HardwareSerial::peek()
+{
+    Impl& port = impl();
+    std::lock_guard<std::mutex> lock{port.lock};
+    return port.rxBuffer.empty() ? -1 : port.rxBuffer.front();
+}
+
+int HardwareSerial::read()
+{
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+size_t HardwareSerial::read(uint8_t* buffer, size_t size)
+{
+    Impl& port = impl();
+    std::lock_guard<std::mutex> lock{port.lock};
+
+    size_t count = std::min(size, port.rxBuffer.size());
+    std::copy_n(port.rxBuffer.begin(), count, buffer);
+    port.rxBuffer.erase(port.rxBuffer.begin(), port.rxBuffer.begin() + count);
+    return count;
+}
+
+size_t HardwareSerial::readBytes(char* buffer, size_t length)
+{
+    size_t count = 0;
+    unsigned long start = millis();
+
+    while (count < length)
+    {
+        count += read(reinterpret_cast<uint8_t*>(buffer) + count, length - count);
+
+        if (count < length)
+        {
+            if (millis() - start >= timeout_)
+                break;
+
+            delay(1);
+        }
+    }
+
+    return count;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size)
+{
+    Impl& port = impl();
+    if (port.fd < 0)
+        return 0;
+
+    size_t written = 0;
+    while (written < size)
+    {
+        ssize_t count = ::write(port.fd, buffer + written, size - written);
+        if (count > 0)
+        {
+            written += count;
+        }
+        else if (count < 0 && errno == EAGAIN)
+        {
+            pollfd pfd = {port.fd, POLLOUT, 0};
+            poll(&pfd, 1, 100);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return written;
+}
+
+void HardwareSerial::flush()
+{
+    Impl& port = impl();
+    if (port.fd >= 0)
+        tcdrain(port.fd);
+}
+
+void HardwareSerial::onReceive(OnReceiveCb function, bool onlyOnTimeout)
+{
+    Impl& port = impl();
+    std::lock_guard<std::mutex> lock{port.lock};
+    port.onReceive = function;
+    port.onlyOnTimeout = onlyOnTimeout;
+}
+
+bool HardwareSerial::setRxTimeout(uint8_t symbolsTimeout)
+{
+    impl().rxTimeoutSymbols = symbolsTimeout;
+    return true;
+}
+
+bool HardwareSerial::setRxFIFOFull(uint8_t fifoBytes)
+{
+    impl().rxFifoFull = fifoBytes;
+    return true;
+}
+
+size_t HardwareSerial::setRxBufferSize(size_t size)
+{
+    Impl& port = impl();
+    std::lock_guard<std::mutex> lock{port.lock};
+    port.rxBufferSize = size;
+    return size;
+}
+
+size_t HardwareSerial::setTxBufferSize(size_t size)
+{
+    return size;
+}
+
+bool native_serial_tx_done(uint8_t uartNum)
+{
+    return HardwareSerial(uartNum).txDone();
+}
+
+bool HardwareSerial::txDone() const
+{
+    int fd = impl().fd;
+    int pending = 0;
+    if (fd < 0 || ioctl(fd, TIOCOUTQ, &pending) != 0)
+        return true;
+
+    return pending == 0;
+}
+
+HardwareSerial::operator bool() const
+{
+    return impl().fd >= 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Arduino.h"
+
+#include <functional>
+
+#define SERIAL_8N1 0x800001c
+#define SERIAL_8E1 0x800001e
+
+/*
+ * Serial port backed by a Linux tty (e.g. a USB-serial adapter wired to CN105, or the pseudo-terminal
+ * created by tools/cn105_emulator). The device path is taken from the EHAL_SERIAL_DEVICE environment
+ * variable. Received bytes raise the interrupt attached to the configured RX pin, like the UART GPIO does,
+ * and the onReceive() callback is raised after an idle gap / FIFO-full worth of bytes like the UART driver.
+ *
+ * Port state lives in a per-UART table rather than the object, so copies ("HardwareSerial port = Serial1;")
+ * refer to the same port as on the ESP32.
+ */
+class HardwareSerial : public Stream
+{
+  public:
+    using OnReceiveCb = std::function<void(void)>;
+
+    constexpr explicit HardwareSerial(uint8_t uartNum)
+        : uartNum_(uartNum)
+    {
+    }
+
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1);
+    void end();
+
+    int available() override;
+    int availableForWrite() override;
+    int peek() override;
+    int read() override;
+    size_t read(uint8_t* buffer, size_t size);
+    size_t readBytes(char* buffer, size_t length) override;
+    using Stream::readBytes;
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    void flush() override;
+
+    void onReceive(OnReceiveCb function, bool onlyOnTimeout = false);
+    bool setRxTimeout(uint8_t symbolsTimeout);
+    bool setRxFIFOFull(uint8_t fifoBytes);
+    size_t setRxBufferSize(size_t size);
+    size_t setTxBufferSize(size_t size);
+
+    operator bool() const;
+    bool txDone() const;
+
+  private:
+    struct Impl;
+    Impl& impl() const;
+
+    uint8_t uartNum_;
+};
+
+extern HardwareSerial Serial1;
+
+// Returns true when the tty's output queue is empty (stands in for uart_wait_tx_done).
+bool native_serial_tx_done(uint8_t uartNum);
@@ -0,0 +1,42 @@
+#include "IPAddress.h"
+
+#include <arpa/inet.h>
+
+IPAddress::IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+    : octets_{a, b, c, d}
+{
+}
+
+IPAddress::IPAddress(uint32_t address)
+{
+    memcpy(octets_, &address, sizeof(octets_));
+}
+
+uint8_t IPAddress::operator[](int index) const
+{
+    return octets_[index & 3];
+}
+
+IPAddress::operator uint32_t() const
+{
+    uint32_t address;
+    memcpy(&address, octets_, sizeof(address));
+    return address;
+}
+
+bool IPAddress::fromString(const char* address)
+{
+    in_addr parsed = {};
+    if (inet_pton(AF_INET, address, &parsed) != 1)
+        return false;
+
+    memcpy(octets_, &parsed.s_addr, sizeof(octets_));
+    return true;
+}
+
+String IPAddress::toString() const
+{
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", octets_[0], octets_[1], octets_[2], octets_[3]);
+    return buffer;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Arduino.h"
+
+class IPAddress
+{
+  public:
+    IPAddress() = default;
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d);
+    explicit IPAddress(uint32_t address);
+
+    uint8_t operator[](int index) const;
+    operator uint32_t() const;
+    bool fromString(const char* address);
+    String toString() const;
+
+  private:
+    uint8_t octets_[4] = {};
+};
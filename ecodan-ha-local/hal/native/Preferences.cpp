@@ -0,0 +1,193 @@
+#include "Preferences.h"
+
+#include <fstream>
+#include <mutex>
+
+#define PREFERENCES_FILE_DEFAULT "ehal_prefs.txt"
+
+namespace
+{
+    std::mutex preferencesLock;
+
+    const char* preferences_path()
+    {
+        const char* path = getenv("EHAL_PREFS");
+        return path ? path : PREFERENCES_FILE_DEFAULT;
+    }
+
+    std::string escape(const std::string& value)
+    {
+        std::string out;
+        for (char c : value)
+        {
+            if (c == '\\')
+                out += "\\\\";
+            else if (c == '\n')
+                out += "\\n";
+            else
+                out += c;
+        }
+        return out;
+    }
+
+    std::string unescape(const std::string& value)
+    {
+        std::string out;
+        for (size_t i = 0; i < value.size(); ++i)
+        {
+            if (value[i] == '\\' && i + 1 < value.size())
+                out += value[++i] == 'n' ? '\n' : value[i];
+            else
+                out += value[i];
+        }
+        return out;
+    }
+} // namespace
+
+bool Preferences::begin(const char* name, bool readOnly)
+{
+    namespace_ = name;
+    readOnly_ = readOnly;
+    started_ = true;
+    load();
+    return true;
+}
+
+void Preferences::end()
+{
+    started_ = false;
+    entries_.clear();
+}
+
+void Preferences::load()
+{
+    std::lock_guard<std::mutex> lock{preferencesLock};
+
+    entries_.clear();
+    std::ifstream file{preferences_path()};
+    std::string line;
+    while (std::getline(file, line))
+    {
+        size_t separator = line.find('=');
+        if (separator != std::string::npos)
+            entries_[line.substr(0, separator)] = unescape(line.substr(separator + 1));
+    }
+}
+
+void Preferences::save()
+{
+    std::lock_guard<std::mutex> lock{preferencesLock};
+
+    std::ofstream file{preferences_path(), std::ios::trunc};
+    for (const auto& entry : entries_)
+        file << entry.first << '=' << escape(entry.second) << '\n';
+}
+
+bool Preferences::clear()
+{
+    if (!started_ || readOnly_)
+        return false;
+
+    std::string prefix = std::string(namespace_.c_str()) + ".";
+    for (auto it = entries_.begin(); it != entries_.end();)
+    {
+        if (it->first.compare(0, prefix.size(), prefix) == 0)
+            it = entries_.erase(it);
+        else
+            ++it;
+    }
+
+    save();
+    return true;
+}
+
+bool Preferences::remove(const char* key)
+{
+    if (!started_ || readOnly_)
+        return false;
+
+    entries_.erase(std::string(namespace_.c_str()) + "." + key);
+    save();
+    return true;
+}
+
+bool Preferences::isKey(const char* key)
+{
+    return entries_.count(std::string(namespace_.c_str()) + "." + key) > 0;
+}
+
+size_t Preferences::put(const char* key, const String& value)
+{
+    if (!started_ || readOnly_)
+        return 0;
+
+    entries_[std::string(namespace_.c_str()) + "." + key] = value.c_str();
+    save();
+    return value.length();
+}
+
+size_t Preferences::putString(const char* key, const String& value)
+{
+    return put(key, value);
+}
+
+size_t Preferences::putUChar(const char* key, uint8_t value)
+{
+    return put(key, String(static_cast<unsigned int>(value))) ? sizeof(value) : 0;
+}
+
+size_t Preferences::putUShort(const char* key, uint16_t value)
+{
+    return put(key, String(static_cast<unsigned int>(value))) ? sizeof(value) : 0;
+}
+
+size_t Preferences::putBool(const char* key, bool value)
+{
+    return put(key, value ? "1" : "0") ? sizeof(value) : 0;
+}
+
+size_t Preferences::putUInt(const char* key, uint32_t value)
+{
+    return put(key, String(static_cast<unsigned long>(value))) ? sizeof(value) : 0;
+}
+
+size_t Preferences::putFloat(const char* key, float value)
+{
+    return put(key, String(value, 6)) ? sizeof(value) : 0;
+}
+
+String Preferences::getString(const char* key, const String& defaultValue)
+{
+    auto it = entries_.find(std::string(namespace_.c_str()) + "." + key);
+    return it != entries_.end() ? String(it->second) : defaultValue;
+}
+
+uint8_t Preferences::getUChar(const char* key, uint8_t defaultValue)
+{
+    auto it = entries_.find(std::string(namespace_.c_str()) + "." + key);
+    return it != entries_.end() ? static_cast<uint8_t>(strtoul(it->second.c_str(), nullptr, 10)) : defaultValue;
+}
+
+uint16_t Preferences::getUShort(const char* key, uint16_t defaultValue)
+{
+    auto it = entries_.find(std::string(namespace_.c_str()) + "." + key);
+    return it != entries_.end() ? static_cast<uint16_t>(strtoul(it->second.c_str(), nullptr, 10)) : defaultValue;
+}
+
+bool Preferences::getBool(const char* key, bool defaultValue)
+{
+    auto it = entries_.find(std::string(namespace_.c_str()) + "." + key);
+    return it != entries_.end() ? it->second == "1" : defaultValue;
+}
+
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue)
+{
+    auto it = entries_.find(std::string(namespace_.c_str()) + "." + key);
+    return it != entries_.end() ? static_cast<uint32_t>(strtoul(it->second.c_str(), nullptr, 10)) : defaultValue;
+}
+
+float Preferences::getFloat(const char* key, float defaultValue)
+{
+    auto it = entries_.find(std::string(namespace_.c_str()) + "." + key);
+    return it != entries_.end() ? strtof(it->second.c_str(), nullptr) : defaultValue;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Arduino.h"
+
+#include <map>
+
+/*
+ * Key/value store with the ESP32 Preferences (NVS) API, persisted as one "namespace.key=value" line per
+ * entry in the file named by the EHAL_PREFS environment variable (default ./ehal_prefs.txt).
+ */
+class Preferences
+{
+  public:
+    bool begin(const char* name, bool readOnly = false);
+    void end();
+    bool clear();
+    bool remove(const char* key);
+    bool isKey(const char* key);
+
+    size_t putString(const char* key, const String& value);
+    size_t putUChar(const char* key, uint8_t value);
+    size_t putUShort(const char* key, uint16_t value);
+    size_t putBool(const char* key, bool value);
+    size_t putUInt(const char* key, uint32_t value);
+    size_t putFloat(const char* key, float value);
+
+    String getString(const char* key, const String& defaultValue = String());
+    uint8_t getUChar(const char* key, uint8_t defaultValue = 0);
+    uint16_t getUShort(const char* key, uint16_t defaultValue = 0);
+    bool getBool(const char* key, bool defaultValue = false);
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+    float getFloat(const char* key, float defaultValue = NAN);
+
+  private:
+    size_t put(const char* key, const String& value);
+    void load();
+    void save();
+
+    String namespace_;
+    bool readOnly_ = true;
+    bool started_ = false;
+    std::map<std::string, std::string> entries_;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Arduino.h"
+
+#define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
+
+// Firmware updates are rejected on the host, rebuild the native binary instead.
+class UpdateClass
+{
+  public:
+    bool begin(size_t size = UPDATE_SIZE_UNKNOWN)
+    {
+        return false;
+    }
+
+    size_t write(uint8_t* data, size_t len)
+    {
+        return 0;
+    }
+
+    bool end(bool evenIfRemaining = false)
+    {
+        return false;
+    }
+
+    const char* errorString()
+    {
+        return "Firmware update is not supported by the native build";
+    }
+};
+
+inline UpdateClass Update;
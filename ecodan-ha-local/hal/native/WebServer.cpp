@@ -0,0 +1,477 @@
+#include "WebServer.h"
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+
+#define WEBSERVER_DEFAULT_PORT 8080
+#define WEBSERVER_READ_TIMEOUT_MS 2000
+#define WEBSERVER_MAX_REQUEST_SIZE (4 * 1024 * 1024)
+
+namespace
+{
+    String url_decode(const String& encoded)
+    {
+        String decoded;
+        decoded.reserve(encoded.length());
+
+        for (unsigned int i = 0; i < encoded.length(); ++i)
+        {
+            char c = encoded[i];
+            if (c == '+')
+            {
+                decoded.concat(' ');
+            }
+            else if (c == '%' && i + 2 < encoded.length())
+            {
+                char hex[3] = {encoded[i + 1], encoded[i + 2], 0};
+                decoded.concat(static_cast<char>(strtol(hex, nullptr, 16)));
+                i += 2;
+            }
+            else
+            {
+                decoded.concat(c);
+            }
+        }
+
+        return decoded;
+    }
+
+    const char* status_text(int code)
+    {
+        switch (code)
+        {
+        case 200:
+            return "OK";
+        case 202:
+            return "Accepted";
+        case 302:
+            return "Found";
+        case 400:
+            return "Bad Request";
+        case 404:
+            return "Not Found";
+        case 500:
+            return "Internal Server Error";
+        default:
+            return "";
+        }
+    }
+
+    HTTPMethod parse_method(const String& method)
+    {
+        if (method == "GET")
+            return HTTP_GET;
+        if (method == "HEAD")
+            return HTTP_HEAD;
+        if (method == "POST")
+            return HTTP_POST;
+        if (method == "PUT")
+            return HTTP_PUT;
+        if (method == "PATCH")
+            return HTTP_PATCH;
+        if (method == "DELETE")
+            return HTTP_DELETE;
+        if (method == "OPTIONS")
+            return HTTP_OPTIONS;
+
+        return HTTP_ANY;
+    }
+} // namespace
+
+WebServer::WebServer(int port)
+    : port_(port)
+{
+}
+
+WebServer::~WebServer()
+{
+    if (listenFd_ >= 0)
+        close(listenFd_);
+}
+
+void WebServer::begin()
+{
+    const char* portOverride = getenv("EHAL_HTTP_PORT");
+    port_ = portOverride ? atoi(portOverride) : WEBSERVER_DEFAULT_PORT;
+
+    listenFd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd_ < 0)
+        return;
+
+    int reuse = 1;
+    setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port_);
+
+    if (bind(listenFd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenFd_, 8) != 0)
+    {
+        fprintf(stderr, "Failed to listen for HTTP on port %d: %s\n", port_, strerror(errno));
+        close(listenFd_);
+        listenFd_ = -1;
+        return;
+    }
+
+    fprintf(stderr, "HTTP server listening on port %d\n", port_);
+}
+
+void WebServer::handleClient()
+{
+    if (listenFd_ < 0)
+        return;
+
+    clientFd_ = accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (clientFd_ < 0)
+        return;
+
+    args_.clear();
+    headers_.clear();
+    responseHeaders_.clear();
+    body_ = String();
+    contentLength_ = CONTENT_LENGTH_NOT_SET;
+    headersSent_ = false;
+    chunked_ = false;
+
+    if (read_request())
+    {
+        const Route* match = nullptr;
+        for (const auto& route : routes_)
+        {
+            if (route.uri == uri_ && (route.method == HTTP_ANY || route.method == method_))
+            {
+                match = &route;
+                break;
+            }
+        }
+
+        String contentType = header("Content-Type");
+        if (match && match->uploadHandler && contentType.startsWith("multipart/form-data"))
+            handle_multipart(*match, body_, contentType);
+
+        if (match)
+            match->handler();
+        else if (notFoundHandler_)
+            notFoundHandler_();
+        else
+            send(404, "text/plain", "Not found");
+
+        if (chunked_)
+            write_raw("0\r\n\r\n", 5);
+    }
+
+    close(clientFd_);
+    clientFd_ = -1;
+}
+
+bool WebServer::read_request()
+{
+    std::string request;
+    size_t headerEnd = std::string::npos;
+    size_t expectedSize = 0;
+    char buffer[4096];
+
+    while (request.size() < WEBSERVER_MAX_REQUEST_SIZE)
+    {
+        if (headerEnd != std::string::npos && request.size() >= expectedSize)
+            break;
+
+        pollfd pfd = {clientFd_, POLLIN, 0};
+        if (poll(&pfd, 1, WEBSERVER_READ_TIMEOUT_MS) != 1)
+            return false;
+
+        ssize_t count = recv(clientFd_, buffer, sizeof(buffer), 0);
+        if (count <= 0)
+            return false;
+
+        request.append(buffer, count);
+
+        if (headerEnd == std::string::npos)
+        {
+            headerEnd = request.find("\r\n\r\n");
+            if (headerEnd == std::string::npos)
+                continue;
+
+            // Parse request line and headers.
+            size_t lineEnd = request.find("\r\n");
+            String requestLine{request.substr(0, lineEnd)};
+            int methodEnd = requestLine.indexOf(' ');
+            int uriEnd = requestLine.indexOf(' ', methodEnd + 1);
+            if (methodEnd < 0 || uriEnd < 0)
+                return false;
+
+            method_ = parse_method(requestLine.substring(0, methodEnd));
+            String target = requestLine.substring(methodEnd + 1, uriEnd);
+            int queryStart = target.indexOf('?');
+            uri_ = queryStart >= 0 ? target.substring(0, queryStart) : target;
+            if (queryStart >= 0)
+                parse_arguments(target.substring(queryStart + 1));
+
+            size_t pos = lineEnd + 2;
+            while (pos < headerEnd)
+            {
+                size_t next = request.find("\r\n", pos);
+                String line{request.substr(pos, next - pos)};
+                int separator = line.indexOf(':');
+                if (separator > 0)
+                {
+                    String value = line.substring(separator + 1);
+                    value.trim();
+                    headers_.emplace_back(line.substring(0, separator), value);
+                }
+                pos = next + 2;
+            }
+
+            expectedSize = headerEnd + 4 + header("Content-Length").toInt();
+        }
+    }
+
+    body_ = String(request.substr(headerEnd + 4));
+
+    if (header("Content-Type").startsWith("application/x-www-form-urlencoded"))
+        parse_arguments(body_);
+    else if (!body_.isEmpty())
+        args_.emplace_back("plain", body_);
+
+    return true;
+}
+
+void WebServer::parse_arguments(const String& data)
+{
+    unsigned int pos = 0;
+    while (pos < data.length())
+    {
+        int end = data.indexOf('&', pos);
+        if (end < 0)
+            end = data.length();
+
+        String pair = data.substring(pos, end);
+        int separator = pair.indexOf('=');
+        if (separator >= 0)
+            args_.emplace_back(url_decode(pair.substring(0, separator)), url_decode(pair.substring(separator + 1)));
+        else if (!pair.isEmpty())
+            args_.emplace_back(url_decode(pair), String());
+
+        pos = end + 1;
+    }
+}
+
+void WebServer::handle_multipart(const Route& route, const String& body, const String& contentType)
+{
+    int boundaryStart = contentType.indexOf("boundary=");
+    if (boundaryStart < 0)
+        return;
+
+    String boundary = String("--") + contentType.substring(boundaryStart + 9);
+    int partStart = body.indexOf(boundary);
+    int dataStart = body.indexOf("\r\n\r\n", partStart);
+    int dataEnd = body.indexOf(String("\r\n") + boundary, dataStart);
+    if (partStart < 0 || dataStart < 0 || dataEnd < 0)
+        return;
+
+    dataStart += 4;
+
+    upload_.status = UPLOAD_FILE_START;
+    upload_.totalSize = 0;
+    upload_.currentSize = 0;
+    route.uploadHandler();
+
+    for (int offset = dataStart; offset < dataEnd; offset += HTTP_UPLOAD_BUFLEN)
+    {
+        upload_.status = UPLOAD_FILE_WRITE;
+        upload_.currentSize = std::min(HTTP_UPLOAD_BUFLEN, dataEnd - offset);
+        memcpy(upload_.buf, body.c_str() + offset, upload_.currentSize);
+        upload_.totalSize += upload_.currentSize;
+        route.uploadHandler();
+    }
+
+    upload_.status = UPLOAD_FILE_END;
+    upload_.currentSize = 0;
+    route.uploadHandler();
+}
+
+void WebServer::on(const String& uri, THandlerFunction handler)
+{
+    on(uri, HTTP_ANY, handler);
+}
+
+void WebServer::on(const String& uri, HTTPMethod method, THandlerFunction handler)
+{
+    routes_.push_back({uri, method, handler, nullptr});
+}
+
+void WebServer::on(const String& uri, HTTPMethod method, THandlerFunction handler, THandlerFunction uploadHandler)
+{
+    routes_.push_back({uri, method, handler, uploadHandler});
+}
+
+void WebServer::onNotFound(THandlerFunction handler)
+{
+    notFoundHandler_ = handler;
+}
+
+void WebServer::collectHeaders(const char* headerKeys[], size_t headerKeysCount)
+{
+    collectedHeaderKeys_.assign(headerKeys, headerKeys + headerKeysCount);
+}
+
+String WebServer::header(const String& name)
+{
+    for (const auto& header : headers_)
+    {
+        if (header.first.equalsIgnoreCase(name))
+            return header.second;
+    }
+
+    return String();
+}
+
+bool WebServer::hasHeader(const String& name)
+{
+    for (const auto& header : headers_)
+    {
+        if (header.first.equalsIgnoreCase(name))
+            return true;
+    }
+
+    return false;
+}
+
+String WebServer::uri()
+{
+    return uri_;
+}
+
+HTTPMethod WebServer::method()
+{
+    return method_;
+}
+
+String WebServer::arg(const String& name)
+{
+    for (const auto& arg : args_)
+    {
+        if (arg.first == name)
+            return arg.second;
+    }
+
+    return String();
+}
+
+bool WebServer::hasArg(const String& name)
+{
+    for (const auto& arg : args_)
+    {
+        if (arg.first == name)
+            return true;
+    }
+
+    return false;
+}
+
+int WebServer::args()
+{
+    return args_.size();
+}
+
+HTTPUpload& WebServer::upload()
+{
+    return upload_;
+}
+
+void WebServer::setContentLength(size_t contentLength)
+{
+    contentLength_ = contentLength;
+}
+
+void WebServer::sendHeader(const String& name, const String& value, bool first)
+{
+    if (first)
+        responseHeaders_.insert(responseHeaders_.begin(), {name, value});
+    else
+        responseHeaders_.emplace_back(name, value);
+}
+
+void WebServer::send(int code, const String& contentType, const String& content)
+{
+    send(code, contentType.c_str(), content.c_str(), content.length());
+}
+
+void WebServer::send(int code, const char* contentType, const char* content, size_t contentLength)
+{
+    size_t length = contentLength_ == CONTENT_LENGTH_NOT_SET ? contentLength : contentLength_;
+    write_headers(code, contentType, length);
+
+    if (contentLength > 0)
+        sendContent(content, contentLength);
+}
+
+void WebServer::sendContent(const String& content)
+{
+    sendContent(content.c_str(), content.length());
+}
+
+void WebServer::sendContent(const char* content, size_t contentLength)
+{
+    if (chunked_)
+    {
+        if (contentLength == 0)
+            return;
+
+        char size[20];
+        int sizeLength = snprintf(size, sizeof(size), "%zx\r\n", contentLength);
+        write_raw(size, sizeLength);
+        write_raw(content, contentLength);
+        write_raw("\r\n", 2);
+    }
+    else
+    {
+        write_raw(content, contentLength);
+    }
+}
+
+void WebServer::write_raw(const char* data, size_t length)
+{
+    size_t written = 0;
+    while (clientFd_ >= 0 && written < length)
+    {
+        ssize_t count = ::send(clientFd_, data + written, length - written, MSG_NOSIGNAL);
+        if (count <= 0)
+            break;
+
+        written += count;
+    }
+}
+
+void WebServer::write_headers(int code, const String& contentType, size_t contentLength)
+{
+    if (headersSent_)
+        return;
+
+    headersSent_ = true;
+    chunked_ = contentLength == CONTENT_LENGTH_UNKNOWN;
+
+    String response = String("HTTP/1.1 ") + String(code) + " " + status_text(code) + "\r\n";
+    if (!contentType.isEmpty())
+        response += String("Content-Type: ") + contentType + "\r\n";
+
+    if (chunked_)
+        response += "Transfer-Encoding: chunked\r\n";
+    else
+        response += String("Content-Length: ") + String(static_cast<unsigned long>(contentLength)) + "\r\n";
+
+    for (const auto& header : responseHeaders_)
+    {
+        if (!header.first.equalsIgnoreCase("Connection"))
+            response += header.first + ": " + header.second + "\r\n";
+    }
+
+    response += "Connection: close\r\n\r\n";
+    write_raw(response.c_str(), response.length());
+}
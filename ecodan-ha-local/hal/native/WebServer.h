@@ -0,0 +1,116 @@
+#pragma once
+
+#include "Arduino.h"
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+#define CONTENT_LENGTH_NOT_SET ((size_t)-2)
+#define HTTP_UPLOAD_BUFLEN 1436
+
+enum HTTPMethod
+{
+    HTTP_ANY,
+    HTTP_GET,
+    HTTP_HEAD,
+    HTTP_POST,
+    HTTP_PUT,
+    HTTP_PATCH,
+    HTTP_DELETE,
+    HTTP_OPTIONS
+};
+
+enum HTTPUploadStatus
+{
+    UPLOAD_FILE_START,
+    UPLOAD_FILE_WRITE,
+    UPLOAD_FILE_END,
+    UPLOAD_FILE_ABORTED
+};
+
+struct HTTPUpload
+{
+    HTTPUploadStatus status;
+    String filename;
+    String name;
+    String type;
+    size_t totalSize;
+    size_t currentSize;
+    uint8_t buf[HTTP_UPLOAD_BUFLEN];
+};
+
+/*
+ * Minimal single-threaded HTTP/1.1 server with the same handler API as the ESP32 WebServer. One request
+ * is served per connection. Port 80 needs root on Linux, so the port is taken from the EHAL_HTTP_PORT
+ * environment variable instead (default 8080).
+ */
+class WebServer
+{
+  public:
+    using THandlerFunction = std::function<void(void)>;
+
+    explicit WebServer(int port = 80);
+    ~WebServer();
+
+    void begin();
+    void handleClient();
+
+    void on(const String& uri, THandlerFunction handler);
+    void on(const String& uri, HTTPMethod method, THandlerFunction handler);
+    void on(const String& uri, HTTPMethod method, THandlerFunction handler, THandlerFunction uploadHandler);
+    void onNotFound(THandlerFunction handler);
+
+    void collectHeaders(const char* headerKeys[], size_t headerKeysCount);
+    String header(const String& name);
+    bool hasHeader(const String& name);
+
+    String uri();
+    HTTPMethod method();
+    String arg(const String& name);
+    bool hasArg(const String& name);
+    int args();
+    HTTPUpload& upload();
+
+    void setContentLength(size_t contentLength);
+    void sendHeader(const String& name, const String& value, bool first = false);
+    void send(int code, const String& contentType = String(), const String& content = String());
+    void send(int code, const char* contentType, const char* content, size_t contentLength);
+    void sendContent(const String& content);
+    void sendContent(const char* content, size_t contentLength);
+
+  private:
+    struct Route
+    {
+        String uri;
+        HTTPMethod method;
+        THandlerFunction handler;
+        THandlerFunction uploadHandler;
+    };
+
+    bool read_request();
+    void parse_arguments(const String& data);
+    void handle_multipart(const Route& route, const String& body, const String& contentType);
+    void write_raw(const char* data, size_t length);
+    void write_headers(int code, const String& contentType, size_t contentLength);
+
+    int port_;
+    int listenFd_ = -1;
+    int clientFd_ = -1;
+
+    std::vector<Route> routes_;
+    THandlerFunction notFoundHandler_;
+    std::vector<String> collectedHeaderKeys_;
+
+    HTTPMethod method_ = HTTP_GET;
+    String uri_;
+    String body_;
+    std::vector<std::pair<String, String>> args_;
+    std::vector<std::pair<String, String>> headers_;
+    std::vector<std::pair<String, String>> responseHeaders_;
+    size_t contentLength_ = CONTENT_LENGTH_NOT_SET;
+    bool headersSent_ = false;
+    bool chunked_ = false;
+    HTTPUpload upload_ = {};
+};
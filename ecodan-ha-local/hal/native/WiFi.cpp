@@ -0,0 +1,129 @@
+#include "WiFi.h"
+
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <unistd.h>
+
+WiFiClass WiFi;
+
+bool WiFiClass::begin(const char* ssid, const char* passphrase)
+{
+    ssid_ = ssid;
+    return true;
+}
+
+bool WiFiClass::reconnect()
+{
+    return true;
+}
+
+bool WiFiClass::isConnected()
+{
+    return true;
+}
+
+bool WiFiClass::setAutoReconnect(bool autoReconnect)
+{
+    return true;
+}
+
+bool WiFiClass::softAP(const char* ssid, const char* passphrase)
+{
+    ssid_ = ssid;
+    return true;
+}
+
+const char* WiFiClass::getHostname()
+{
+    if (hostname_.isEmpty())
+    {
+        char buffer[256] = {};
+        gethostname(buffer, sizeof(buffer) - 1);
+        hostname_ = buffer;
+    }
+
+    return hostname_.c_str();
+}
+
+bool WiFiClass::setHostname(const char* hostname)
+{
+    hostname_ = hostname;
+    return true;
+}
+
+IPAddress WiFiClass::localIP()
+{
+    IPAddress address{127, 0, 0, 1};
+
+    ifaddrs* interfaces = nullptr;
+    if (getifaddrs(&interfaces) != 0)
+        return address;
+
+    for (ifaddrs* it = interfaces; it; it = it->ifa_next)
+    {
+        if (!it->ifa_addr || it->ifa_addr->sa_family != AF_INET || (it->ifa_flags & IFF_LOOPBACK))
+            continue;
+
+        address = IPAddress(reinterpret_cast<sockaddr_in*>(it->ifa_addr)->sin_addr.s_addr);
+        break;
+    }
+
+    freeifaddrs(interfaces);
+    return address;
+}
+
+IPAddress WiFiClass::gatewayIP()
+{
+    return IPAddress();
+}
+
+IPAddress WiFiClass::softAPIP()
+{
+    return localIP();
+}
+
+String WiFiClass::macAddress()
+{
+    uint64_t mac = ESP.getEfuseMac();
+
+    char buffer[18];
+    snprintf(buffer, sizeof(buffer), "%02X:%02X:%02X:%02X:%02X:%02X",
+             static_cast<uint8_t>(mac), static_cast<uint8_t>(mac >> 8), static_cast<uint8_t>(mac >> 16),
+             static_cast<uint8_t>(mac >> 24), static_cast<uint8_t>(mac >> 32), static_cast<uint8_t>(mac >> 40));
+    return buffer;
+}
+
+String WiFiClass::SSID()
+{
+    return ssid_;
+}
+
+int8_t WiFiClass::RSSI()
+{
+    return 0;
+}
+
+int16_t WiFiClass::scanNetworks(bool async)
+{
+    return 0;
+}
+
+int16_t WiFiClass::scanComplete()
+{
+    return 0;
+}
+
+void WiFiClass::scanDelete()
+{
+}
+
+String WiFiClass::SSID(uint8_t index)
+{
+    return String();
+}
+
+int32_t WiFiClass::RSSI(uint8_t index)
+{
+    return 0;
+}
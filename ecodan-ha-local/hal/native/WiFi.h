@@ -0,0 +1,42 @@
+#pragma once
+
+#include "IPAddress.h"
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+
+/*
+ * The host is assumed to already be on the network: the station is always "connected", using the address
+ * of the first non-loopback IPv4 interface.
+ */
+class WiFiClass
+{
+  public:
+    bool begin(const char* ssid, const char* passphrase = nullptr);
+    bool reconnect();
+    bool isConnected();
+    bool setAutoReconnect(bool autoReconnect);
+    bool softAP(const char* ssid, const char* passphrase = nullptr);
+
+    const char* getHostname();
+    bool setHostname(const char* hostname);
+
+    IPAddress localIP();
+    IPAddress gatewayIP();
+    IPAddress softAPIP();
+    String macAddress();
+    String SSID();
+    int8_t RSSI();
+
+    int16_t scanNetworks(bool async = false);
+    int16_t scanComplete();
+    void scanDelete();
+    String SSID(uint8_t index);
+    int32_t RSSI(uint8_t index);
+
+  private:
+    String hostname_;
+    String ssid_;
+};
+
+extern WiFiClass WiFi;
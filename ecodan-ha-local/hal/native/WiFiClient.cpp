@@ -0,0 +1,192 @@
+#include "WiFiClient.h"
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+#define WIFI_CLIENT_CONNECT_TIMEOUT_MS 3000
+
+WiFiClient::WiFiClient() = default;
+
+WiFiClient::~WiFiClient()
+{
+    stop();
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port)
+{
+    return connect(ip.toString().c_str(), port);
+}
+
+int WiFiClient::connect(const char* host, uint16_t port)
+{
+    return connect(host, port, WIFI_CLIENT_CONNECT_TIMEOUT_MS);
+}
+
+int WiFiClient::connect(const char* host, uint16_t port, int32_t timeoutMs)
+{
+    stop();
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host, String(static_cast<unsigned int>(port)).c_str(), &hints, &result) != 0)
+        return 0;
+
+    for (addrinfo* it = result; it && fd_ < 0; it = it->ai_next)
+    {
+        int fd = socket(it->ai_family, it->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, it->ai_protocol);
+        if (fd < 0)
+            continue;
+
+        if (::connect(fd, it->ai_addr, it->ai_addrlen) != 0 && errno != EINPROGRESS)
+        {
+            close(fd);
+            continue;
+        }
+
+        pollfd pfd = {fd, POLLOUT, 0};
+        int error = 0;
+        socklen_t errorLen = sizeof(error);
+        if (poll(&pfd, 1, timeoutMs) != 1 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &errorLen) != 0 || error != 0)
+        {
+            close(fd);
+            continue;
+        }
+
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        fd_ = fd;
+    }
+
+    freeaddrinfo(result);
+    return fd_ >= 0 ? 1 : 0;
+}
+
+size_t WiFiClient::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t WiFiClient::write(const uint8_t* buffer, size_t size)
+{
+    size_t written = 0;
+    while (fd_ >= 0 && written < size)
+    {
+        ssize_t count = send(fd_, buffer + written, size - written, MSG_NOSIGNAL);
+        if (count > 0)
+        {
+            written += count;
+        }
+        else if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            pollfd pfd = {fd_, POLLOUT, 0};
+            if (poll(&pfd, 1, WIFI_CLIENT_CONNECT_TIMEOUT_MS) != 1)
+                break;
+        }
+        else
+        {
+            stop();
+        }
+    }
+
+    return written;
+}
+
+int WiFiClient::available()
+{
+    if (fd_ < 0)
+        return 0;
+
+    int count = 0;
+    if (ioctl(fd_, FIONREAD, &count) != 0)
+        return 0;
+
+    return count + (peeked_ >= 0 ? 1 : 0);
+}
+
+int WiFiClient::read()
+{
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t* buffer, size_t size)
+{
+    if (size == 0)
+        return 0;
+
+    int count = 0;
+    if (peeked_ >= 0)
+    {
+        buffer[count++] = static_cast<uint8_t>(peeked_);
+        peeked_ = -1;
+    }
+
+    if (fd_ < 0 || static_cast<size_t>(count) == size)
+        return count > 0 ? count : -1;
+
+    ssize_t received = recv(fd_, buffer + count, size - count, 0);
+    if (received > 0)
+        count += received;
+    else if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+        stop();
+
+    return count > 0 ? count : -1;
+}
+
+int WiFiClient::peek()
+{
+    if (peeked_ < 0)
+        peeked_ = read();
+
+    return peeked_;
+}
+
+void WiFiClient::flush()
+{
+}
+
+void WiFiClient::stop()
+{
+    if (fd_ >= 0)
+    {
+        close(fd_);
+        fd_ = -1;
+    }
+
+    peeked_ = -1;
+}
+
+uint8_t WiFiClient::connected()
+{
+    if (fd_ < 0)
+        return 0;
+
+    pollfd pfd = {fd_, POLLIN, 0};
+    if (poll(&pfd, 1, 0) == 1)
+    {
+        char c;
+        if ((pfd.revents & (POLLHUP | POLLERR)) || recv(fd_, &c, 1, MSG_PEEK) == 0)
+        {
+            stop();
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+WiFiClient::operator bool()
+{
+    return connected();
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdlib>
+
+// The host has no PSRAM, allocations come from the regular heap.
+inline bool psramFound()
+{
+    return false;
+}
+
+inline bool psramInit()
+{
+    return false;
+}
+
+inline void* ps_malloc(size_t size)
+{
+    return malloc(size);
+}
@@ -0,0 +1,371 @@
+/*
+ * Entry point for the native (Linux) build. Runs the sketch's setup() / loop() against the host shims in
+ * this directory, so the firmware can be exercised against a real CN105 adapter or tools/cn105_emulator.
+ *
+ *   ecodan-ha-local [--serial <tty>] [--http-port <port>] [--prefs <file>]
+ *   ecodan-ha-local --replay <capture.pcap>
+ *   ecodan-ha-local --self-test
+ */
+
+#include "../../ecodan-ha-local.ino"
+#include "../../ehal_capture.h"
+#include "../../ehal_hp_registers.h"
+#include "../../ehal_hp_settings.h"
+#include "../../ehal_proto.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+#define REPLAY_BENCH_PASSES 1000
+
+namespace
+{
+    void usage(const char* argv0)
+    {
+        fprintf(stderr, "usage: %s [--serial <tty>] [--http-port <port>] [--prefs <file>]\n", argv0);
+        fprintf(stderr, "       %s --replay <capture.pcap>\n", argv0);
+        fprintf(stderr, "       %s --self-test\n", argv0);
+    }
+
+    void expect(bool ok, const char* what, int& failures)
+    {
+        if (ok)
+            return;
+
+        fprintf(stderr, "FAIL: %s\n", what);
+        ++failures;
+    }
+
+    ehal::hp::Message setting_cmd(ehal::hp::SetType type, uint8_t flags)
+    {
+        ehal::hp::Message cmd{ehal::hp::MsgType::SET_CMD, type};
+        cmd[1] = flags;
+        return cmd;
+    }
+
+    ehal::hp::Message zone_temperature_cmd(float z1, uint8_t controlMode = 0)
+    {
+        auto cmd = setting_cmd(ehal::hp::SetType::BASIC_SETTINGS, SET_SETTINGS_FLAG_ZONE_TEMPERATURE);
+        cmd[2] = static_cast<uint8_t>(ehal::hp::SetZone::ZONE_1);
+        cmd[6] = controlMode;
+        cmd.set_float16(z1, 10);
+        return cmd;
+    }
+
+    ehal::hp::Message dhw_temperature_cmd(float temperature)
+    {
+        auto cmd = setting_cmd(ehal::hp::SetType::BASIC_SETTINGS, SET_SETTINGS_FLAG_DHW_TEMPERATURE);
+        cmd.set_float16(temperature, 8);
+        return cmd;
+    }
+
+    // Frames setting different flags merge, taking only the bytes each flag carries; frames setting the same
+    // flag, disagreeing on a shared byte, or of another SetType don't.
+    int test_merge_basic_settings()
+    {
+        using namespace ehal;
+        int failures = 0;
+
+        auto into = zone_temperature_cmd(21.5f);
+        auto dhw = dhw_temperature_cmd(50.0f);
+        expect(hp::merge_basic_settings(into, dhw), "zone + DHW temperature merge", failures);
+        expect(into[1] == (SET_SETTINGS_FLAG_ZONE_TEMPERATURE | SET_SETTINGS_FLAG_DHW_TEMPERATURE), "merged flags", failures);
+        expect(into.get_float16(10) == 21.5f, "merged zone 1 temperature kept", failures);
+        expect(into.get_float16(8) == 50.0f, "merged DHW temperature taken", failures);
+        expect(into[2] == static_cast<uint8_t>(hp::SetZone::ZONE_1), "merged zone kept", failures);
+
+        auto again = zone_temperature_cmd(22.0f);
+        expect(!hp::merge_basic_settings(into, again), "same flag doesn't merge", failures);
+        expect(into.get_float16(10) == 21.5f, "rejected merge leaves frame untouched", failures);
+
+        auto flow = zone_temperature_cmd(40.0f, static_cast<uint8_t>(hp::SetHpMode::FLOW_CONTROL_MODE));
+        auto conflicting = setting_cmd(hp::SetType::BASIC_SETTINGS, SET_SETTINGS_FLAG_HP_MODE);
+        conflicting[6] = static_cast<uint8_t>(hp::SetHpMode::COMPENSATION_CURVE_MODE);
+        expect(!hp::merge_basic_settings(flow, conflicting), "conflicting byte 6 doesn't merge", failures);
+
+        auto agreeing = setting_cmd(hp::SetType::BASIC_SETTINGS, SET_SETTINGS_FLAG_HP_MODE);
+        agreeing[6] = static_cast<uint8_t>(hp::SetHpMode::FLOW_CONTROL_MODE);
+        expect(hp::merge_basic_settings(flow, agreeing), "agreeing byte 6 merges", failures);
+        expect(flow[1] == (SET_SETTINGS_FLAG_ZONE_TEMPERATURE | SET_SETTINGS_FLAG_HP_MODE), "zone + HP mode flags", failures);
+
+        auto force = setting_cmd(hp::SetType::DHW_SETTING, SET_SETTINGS_FLAG_MODE_TOGGLE);
+        auto power = setting_cmd(hp::SetType::BASIC_SETTINGS, SET_SETTINGS_FLAG_MODE_TOGGLE);
+        expect(!hp::merge_basic_settings(power, force), "DHW_SETTING doesn't merge into BASIC_SETTINGS", failures);
+
+        return failures;
+    }
+
+    // A later change to a held setting replaces its frame but keeps its place, request time and due time; held
+    // settings are released in the order they were first changed, once their own window has closed.
+    int test_setting_coalescing()
+    {
+        using namespace ehal;
+        using namespace std::chrono_literals;
+        int failures = 0;
+
+        std::vector<hp::PendingSetting> pending;
+        auto t0 = std::chrono::steady_clock::time_point{} + 1h;
+
+        auto z1 = zone_temperature_cmd(21.0f);
+        auto force = setting_cmd(hp::SetType::DHW_SETTING, SET_SETTINGS_FLAG_MODE_TOGGLE);
+        auto dhw = dhw_temperature_cmd(48.0f);
+        auto z1Again = zone_temperature_cmd(22.0f);
+        expect(hp::hold_pending_setting(pending, hp::Setting::ZONE_TEMPERATURE, z1, t0, 1000) == hp::HoldResult::HELD, "zone temperature held", failures);
+        expect(hp::hold_pending_setting(pending, hp::Setting::DHW_FORCE, force, t0 + 100ms, 1000) == hp::HoldResult::HELD, "DHW force held", failures);
+        expect(hp::hold_pending_setting(pending, hp::Setting::DHW_TEMPERATURE, dhw, t0 + 200ms, 1000) == hp::HoldResult::HELD, "DHW temperature held", failures);
+        expect(hp::hold_pending_setting(pending, hp::Setting::ZONE_TEMPERATURE, z1Again, t0 + 900ms, 1000) == hp::HoldResult::REPLACED,
+               "zone temperature replaced", failures);
+
+        expect(pending.size() == 3, "replacement doesn't add a held setting", failures);
+        expect(pending[0].Key == hp::Setting::ZONE_TEMPERATURE, "replacement keeps its place", failures);
+        expect(pending[0].RequestedAt == t0, "replacement keeps RequestedAt", failures);
+        expect(pending[0].Due == t0 + 1000ms, "replacement keeps Due", failures);
+        expect(pending[0].Msg.get_float16(10) == 22.0f, "replacement carries the latest value", failures);
+
+        auto power = setting_cmd(hp::SetType::BASIC_SETTINGS, SET_SETTINGS_FLAG_MODE_TOGGLE);
+        expect(hp::hold_pending_setting(pending, hp::Setting::POWER_MODE, power, t0, 0) == hp::HoldResult::NOT_HELD, "no window, not held", failures);
+        expect(power[1] == SET_SETTINGS_FLAG_MODE_TOGGLE, "setting not held is left to the caller", failures);
+
+        expect(hp::take_due_settings(pending, t0 + 999ms).empty(), "nothing released inside the window", failures);
+
+        auto released = hp::take_due_settings(pending, t0 + 1000ms);
+        expect(released.size() == 1 && pending.size() == 2, "only the first window has closed", failures);
+
+        auto rest = hp::take_due_settings(pending, t0 + 1200ms);
+        expect(rest.size() == 2 && pending.empty(), "remaining windows closed", failures);
+        for (auto& cmd : rest)
+            released.push_back(std::move(cmd));
+
+        if (released.size() == 3)
+        {
+            expect(released[0].Msg[1] == SET_SETTINGS_FLAG_ZONE_TEMPERATURE && released[0].RequestedAt == t0, "zone temperature released first", failures);
+            expect(released[1].Msg.payload_type<hp::SetType>() == hp::SetType::DHW_SETTING, "DHW force released second", failures);
+            expect(released[2].Msg[1] == SET_SETTINGS_FLAG_DHW_TEMPERATURE && released[2].RequestedAt == t0 + 200ms, "DHW temperature released third", failures);
+
+            expect(hp::merge_settings(released) == 1, "one frame saved by merging", failures);
+            expect(released.size() == 2, "released settings merged into two frames", failures);
+            expect(released[0].Msg[1] == (SET_SETTINGS_FLAG_ZONE_TEMPERATURE | SET_SETTINGS_FLAG_DHW_TEMPERATURE), "DHW temperature merged into the first frame", failures);
+            expect(released[0].RequestedAt == t0, "merged frame is as old as its earliest request", failures);
+            expect(released[1].Msg.payload_type<hp::SetType>() == hp::SetType::DHW_SETTING, "DHW force kept its own frame", failures);
+        }
+
+        return failures;
+    }
+
+    // An acknowledged setting reads back each register it's reported in once, and only the last read-back
+    // records the confirmation latency.
+    int test_readbacks()
+    {
+        using namespace ehal;
+        int failures = 0;
+
+        auto t0 = std::chrono::steady_clock::now();
+        auto merged = setting_cmd(hp::SetType::BASIC_SETTINGS, SET_SETTINGS_FLAG_ZONE_TEMPERATURE | SET_SETTINGS_FLAG_DHW_TEMPERATURE | SET_SETTINGS_FLAG_HP_MODE);
+        auto cmds = hp::readback_cmds(merged, t0);
+        expect(cmds.size() == 2, "merged setting reads back 2 registers", failures);
+        if (cmds.size() == 2)
+        {
+            expect(cmds[0].Msg.type() == hp::MsgType::GET_CMD && cmds[0].Msg.payload_type<hp::GetType>() == hp::GetType::TEMPERATURE_CONFIG,
+                   "zone temperature read back from TEMPERATURE_CONFIG", failures);
+            expect(cmds[1].Msg.payload_type<hp::GetType>() == hp::GetType::MODE_FLAGS_A, "DHW temperature and HP mode read back once from MODE_FLAGS_A", failures);
+            expect(!cmds[0].Readback && cmds[1].Readback, "only the last read-back records latency", failures);
+            expect(cmds[0].RequestedAt == t0 && cmds[1].RequestedAt == t0, "read-backs carry the request time", failures);
+        }
+
+        auto force = setting_cmd(hp::SetType::DHW_SETTING, SET_SETTINGS_FLAG_MODE_TOGGLE);
+        cmds = hp::readback_cmds(force, t0);
+        expect(cmds.size() == 2 && !cmds[0].Readback && cmds[1].Readback, "DHW force reads back 2 registers, the last records latency", failures);
+
+        auto dhwMode = setting_cmd(hp::SetType::BASIC_SETTINGS, SET_SETTINGS_FLAG_DHW_MODE);
+        cmds = hp::readback_cmds(dhwMode, t0);
+        expect(cmds.size() == 1 && cmds[0].Readback, "DHW mode reads back 1 register, which records latency", failures);
+
+        return failures;
+    }
+
+    // Feeds a full-length frame followed by a short one through a single FrameParser / Message pair and checks
+    // that none of the long frame's payload bytes survive into the short one.
+    int test_short_frame_payload()
+    {
+        using namespace ehal;
+
+        char longPayload[hp::PAYLOAD_SIZE];
+        memset(longPayload, 0xAA, sizeof(longPayload));
+        longPayload[0] = static_cast<char>(hp::GetType::TEMPERATURE_CONFIG);
+
+        hp::Message longFrame{hp::MsgType::GET_RES};
+        longFrame.write_payload(longPayload, sizeof(longPayload));
+        longFrame.set_checksum();
+
+        const char shortPayload[] = {static_cast<char>(hp::GetType::TEMPERATURE_CONFIG), 0x01, 0x02};
+        hp::Message shortFrame{hp::MsgType::GET_RES};
+        shortFrame.write_payload(shortPayload, sizeof(shortPayload));
+        shortFrame.set_checksum();
+
+        hp::FrameParser parser;
+        hp::Message msg;
+        int failures = 0;
+
+        for (hp::Message* frame : {&longFrame, &shortFrame})
+        {
+            bool parsed = false;
+            for (size_t i = 0; i < frame->size(); ++i)
+                parsed = parser.consume(frame->buffer()[i], msg);
+
+            if (!parsed)
+            {
+                fprintf(stderr, "FAIL: frame of %zu payload bytes not parsed\n", frame->payload_size());
+                ++failures;
+            }
+        }
+
+        for (size_t i = sizeof(shortPayload) + hp::CHECKSUM_SIZE; i < hp::PAYLOAD_SIZE; ++i)
+        {
+            if (msg[i] != 0)
+            {
+                fprintf(stderr, "FAIL: short frame payload[%zu] = %#x, expected 0\n", i, msg[i]);
+                ++failures;
+            }
+        }
+
+        return failures;
+    }
+
+    int self_test()
+    {
+        int failures = test_short_frame_payload() + test_merge_basic_settings() + test_setting_coalescing() + test_readbacks();
+
+        printf("self-test: %s\n", failures ? "FAILED" : "passed");
+        return failures ? 1 : 0;
+    }
+
+    // Feeds the frames received from the heat pump in a capture downloaded from /capture.pcap through the
+    // rx frame parser and register decoder, printing each frame, then times REPLAY_BENCH_PASSES silent passes.
+    int replay_capture(const char* path)
+    {
+        using namespace ehal;
+
+        std::ifstream file(path, std::ios::binary);
+        std::vector<uint8_t> data{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+        capture::PcapFileHeader header = {};
+        if (data.size() < sizeof(header))
+        {
+            fprintf(stderr, "%s: not a capture file\n", path);
+            return 1;
+        }
+
+        memcpy(&header, data.data(), sizeof(header));
+        if (header.Magic != capture::PCAP_MAGIC || header.LinkType != capture::PCAP_LINKTYPE_USER0)
+        {
+            fprintf(stderr, "%s: not a CN105 capture (magic %#x, link type %u)\n", path, header.Magic, header.LinkType);
+            return 1;
+        }
+
+        std::vector<uint8_t> rxBytes;
+        hp::FrameParser parser;
+        hp::Status status;
+        hp::Message msg;
+        size_t offset = sizeof(header);
+
+        while (offset + sizeof(capture::PcapRecordHeader) <= data.size())
+        {
+            capture::PcapRecordHeader record = {};
+            memcpy(&record, data.data() + offset, sizeof(record));
+            offset += sizeof(record);
+
+            if (record.CapturedLength < 1 || offset + record.CapturedLength > data.size())
+                break;
+
+            auto direction = static_cast<capture::Direction>(data[offset]);
+            const uint8_t* frame = data.data() + offset + 1;
+            size_t length = record.CapturedLength - 1;
+            offset += record.CapturedLength;
+
+            printf("%u.%06u %s", record.TimestampSec, record.TimestampUsec, direction == capture::Direction::TX ? "TX" : "RX");
+            for (size_t i = 0; i < length; ++i)
+                printf(" %02x", frame[i]);
+
+            if (direction == capture::Direction::RX)
+            {
+                rxBytes.insert(std::end(rxBytes), frame, frame + length);
+
+                for (size_t i = 0; i < length; ++i)
+                {
+                    if (parser.consume(frame[i], msg) && msg.type() == hp::MsgType::GET_RES)
+                        printf("  changed=%#llx", static_cast<unsigned long long>(hp::decode_registers(msg, status)));
+                }
+            }
+
+            printf("\n");
+        }
+
+        size_t frames = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        for (int pass = 0; pass < REPLAY_BENCH_PASSES; ++pass)
+        {
+            hp::FrameParser benchParser;
+            hp::Status benchStatus;
+
+            for (uint8_t b : rxBytes)
+            {
+                if (benchParser.consume(b, msg))
+                {
+                    ++frames;
+                    if (msg.type() == hp::MsgType::GET_RES)
+                        hp::decode_registers(msg, benchStatus);
+                }
+            }
+        }
+
+        auto elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+        printf("%zu rx frames, %llu bytes dropped, %llu checksum errors\n", frames / REPLAY_BENCH_PASSES,
+               static_cast<unsigned long long>(parser.dropped_bytes()), static_cast<unsigned long long>(parser.checksum_errors()));
+        printf("parse + decode: %.1f ns/frame over %d passes\n", frames ? static_cast<double>(elapsedNs) / frames : 0.0, REPLAY_BENCH_PASSES);
+        return 0;
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            return replay_capture(argv[i + 1]);
+
+        if (strcmp(argv[i], "--self-test") == 0)
+            return self_test();
+
+        const char* env = nullptr;
+        if (strcmp(argv[i], "--serial") == 0)
+            env = "EHAL_SERIAL_DEVICE";
+        else if (strcmp(argv[i], "--http-port") == 0)
+            env = "EHAL_HTTP_PORT";
+        else if (strcmp(argv[i], "--prefs") == 0)
+            env = "EHAL_PREFS";
+
+        if (!env || i + 1 >= argc)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+
+        setenv(env, argv[++i], 1);
+    }
+
+    native_set_restart_args(argc, argv);
+
+    setup();
+
+    while (true)
+    {
+        loop();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
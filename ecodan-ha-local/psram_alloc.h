@@ -22,19 +22,19 @@
 
 namespace psram
 {
-    bool exists()
+    inline bool exists()
     {
         static bool yes = psramFound();
         return yes;
     }
 
-    bool is_non_zero()
+    inline bool is_non_zero()
     {
         static bool nonZero = ESP.getPsramSize() > 0;
         return nonZero;
     }
 
-    bool initialize()
+    inline bool initialize()
     {
         static bool initialized = psramInit();        
         return initialized;
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace ehal
+{
+    // Bounded lock-free queue for exactly one producer thread and one consumer thread.
+    template <typename T, size_t N>
+    class SpscQueue
+    {
+        static_assert(N > 0 && (N & (N - 1)) == 0, "Capacity must be a power of two");
+
+      public:
+        // Producer only, returns false (dropping the item) if the queue is full.
+        bool push(const T& item)
+        {
+            size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail - head_.load(std::memory_order_acquire) == N)
+                return false;
+
+            items_[tail % N] = item;
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer only, returns false if the queue is empty.
+        bool pop(T& item)
+        {
+            size_t head = head_.load(std::memory_order_relaxed);
+            if (head == tail_.load(std::memory_order_acquire))
+                return false;
+
+            item = items_[head % N];
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+      private:
+        std::array<T, N> items_ = {};
+        std::atomic<size_t> head_{0}; // Next item to pop, only written by the consumer.
+        std::atomic<size_t> tail_{0}; // Next slot to push, only written by the producer.
+    };
+} // namespace ehal
@@ -0,0 +1,641 @@
+/*
+ * CN105 heat pump emulator.
+ *
+ * Emulates the FTC end of the CN105 serial link on a Linux pseudo-terminal, so the
+ * serial path of the firmware can be exercised (and timed) without a real heat pump.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -Wall -o cn105_emulator tools/cn105_emulator.cpp
+ *
+ * Run:
+ *   ./cn105_emulator [--link /tmp/ttyCN105] [--latency-ms 40] [--drop-rate 0.0] [--corrupt-rate 0.0] [--seed 1] [--verbose]
+ *
+ * The emulator prints the path of the pty slave it created (and optionally symlinks it to --link),
+ * that path can then be handed to anything which expects to talk to the heat pump at 2400 8E1.
+ *
+ * Bytes are written back at the on-wire rate of 2400 baud with 8E1 framing (11 bits per byte, so a
+ * full 22 byte frame takes ~92ms), after a configurable controller turn-around latency.
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cn105
+{
+    // Keep these in sync with ecodan-ha-local/ehal_proto.h
+    enum class MsgType : uint8_t
+    {
+        SET_CMD = 0x41,
+        SET_RES = 0x61,
+        GET_CMD = 0x42,
+        GET_RES = 0x62,
+        CONNECT_CMD = 0x5A,
+        CONNECT_RES = 0x7A,
+        EXT_CONNECT_CMD = 0x5B,
+        EXT_CONNECT_RES = 0x7B
+    };
+
+    enum class SetType : uint8_t
+    {
+        BASIC_SETTINGS = 0x32,
+        DHW_SETTING = 0x34
+    };
+
+    enum class GetType : uint8_t
+    {
+        DEFROST_STATE = 0x02,
+        COMPRESSOR_FREQUENCY = 0x04,
+        FORCED_DHW_STATE = 0x05,
+        HEATING_POWER = 0x07,
+        TEMPERATURE_CONFIG = 0x09,
+        SH_TEMPERATURE_STATE = 0x0B,
+        DHW_TEMPERATURE_STATE_A = 0x0C,
+        DHW_TEMPERATURE_STATE_B = 0x0D,
+        ACTIVE_TIME = 0x13,
+        FLOW_RATE = 0x14,
+        MODE_FLAGS_A = 0x26,
+        MODE_FLAGS_B = 0x28,
+        ENERGY_USAGE = 0xA1,
+        ENERGY_DELIVERY = 0xA2
+    };
+
+    const uint8_t SET_SETTINGS_FLAG_ZONE_TEMPERATURE = 0x80;
+    const uint8_t SET_SETTINGS_FLAG_DHW_TEMPERATURE = 0x20;
+    const uint8_t SET_SETTINGS_FLAG_HP_MODE = 0x08;
+    const uint8_t SET_SETTINGS_FLAG_DHW_MODE = 0x04;
+    const uint8_t SET_SETTINGS_FLAG_MODE_TOGGLE = 0x01;
+
+    const uint8_t SET_ZONE_1 = 0;
+    const uint8_t SET_ZONE_2 = 1;
+    const uint8_t SET_ZONE_BOTH = 2;
+    const uint8_t SET_HP_MODE_FLOW_CONTROL = 1;
+
+    const uint8_t HEADER_SIZE = 5;
+    const uint8_t PAYLOAD_SIZE = 16;
+    const uint8_t TOTAL_MSG_SIZE = HEADER_SIZE + PAYLOAD_SIZE + 1;
+    const uint8_t HEADER_MAGIC_A = 0xFC;
+    const uint8_t HEADER_MAGIC_B = 0x02;
+    const uint8_t HEADER_MAGIC_C = 0x7A;
+
+    const uint16_t ZONE_NOT_PRESENT = 0xF0C4;
+
+    uint8_t checksum(const uint8_t* data, size_t length)
+    {
+        uint8_t sum = 0;
+        for (size_t i = 0; i < length; ++i)
+            sum += data[i];
+
+        return (0xFC - sum) & 0xFF;
+    }
+
+    struct Frame
+    {
+        MsgType type;
+        uint8_t length = 0;
+        uint8_t payload[PAYLOAD_SIZE] = {};
+
+        std::vector<uint8_t> encode() const
+        {
+            std::vector<uint8_t> out(HEADER_SIZE + length + 1);
+            out[0] = HEADER_MAGIC_A;
+            out[1] = static_cast<uint8_t>(type);
+            out[2] = HEADER_MAGIC_B;
+            out[3] = HEADER_MAGIC_C;
+            out[4] = length;
+            memcpy(out.data() + HEADER_SIZE, payload, length);
+            out[HEADER_SIZE + length] = checksum(out.data(), HEADER_SIZE + length);
+            return out;
+        }
+
+        void set_u16(size_t index, uint16_t value)
+        {
+            payload[index] = value >> 8;
+            payload[index + 1] = value & 0xFF;
+        }
+
+        void set_float16(size_t index, float value)
+        {
+            set_u16(index, static_cast<uint16_t>(std::lround(value * 100.0f)));
+        }
+
+        void set_float24(size_t index, float value)
+        {
+            uint16_t whole = static_cast<uint16_t>(value);
+            set_u16(index, whole);
+            payload[index + 2] = static_cast<uint8_t>(std::lround((value - whole) * 100.0f)) % 100;
+        }
+
+        float get_float16(size_t index) const
+        {
+            return uint16_t(payload[index] << 8 | payload[index + 1]) / 100.0f;
+        }
+    };
+
+    // Incremental frame decoder, scans forward to the next header magic on any error.
+    class Parser
+    {
+      public:
+        bool consume(uint8_t byte, Frame& out)
+        {
+            buffer_.push_back(byte);
+
+            while (!buffer_.empty())
+            {
+                if (buffer_[0] != HEADER_MAGIC_A || (buffer_.size() > 2 && buffer_[2] != HEADER_MAGIC_B) ||
+                    (buffer_.size() > 3 && buffer_[3] != HEADER_MAGIC_C) || (buffer_.size() > 4 && buffer_[4] > PAYLOAD_SIZE))
+                {
+                    drop_to_next_header();
+                    continue;
+                }
+
+                if (buffer_.size() < HEADER_SIZE || buffer_.size() < size_t(HEADER_SIZE + buffer_[4] + 1))
+                    return false;
+
+                size_t length = buffer_[4];
+                if (checksum(buffer_.data(), HEADER_SIZE + length) != buffer_[HEADER_SIZE + length])
+                {
+                    ++checksumErrors;
+                    drop_to_next_header();
+                    continue;
+                }
+
+                out.type = static_cast<MsgType>(buffer_[1]);
+                out.length = length;
+                memset(out.payload, 0, sizeof(out.payload));
+                memcpy(out.payload, buffer_.data() + HEADER_SIZE, length);
+                buffer_.clear();
+                return true;
+            }
+
+            return false;
+        }
+
+        uint64_t droppedBytes = 0;
+        uint64_t checksumErrors = 0;
+
+      private:
+        void drop_to_next_header()
+        {
+            size_t next = 1;
+            while (next < buffer_.size() && buffer_[next] != HEADER_MAGIC_A)
+                ++next;
+
+            droppedBytes += next;
+            buffer_.erase(buffer_.begin(), buffer_.begin() + next);
+        }
+
+        std::vector<uint8_t> buffer_;
+    };
+
+    // Simulated controller state, field names mirror ehal::hp::Status
+    struct State
+    {
+        bool DefrostActive = false;
+        bool DhwForcedActive = false;
+        uint8_t OutputPower = 3;
+        uint8_t CompressorFrequency = 42;
+        uint8_t FlowRate = 18;
+
+        float Zone1SetTemperature = 20.5f;
+        float Zone2SetTemperature = 19.0f;
+        float Zone1FlowTemperatureSetPoint = 35.0f;
+        float Zone2FlowTemperatureSetPoint = 30.0f;
+        float LegionellaPreventionSetPoint = 65.0f;
+        float DhwTemperatureDrop = 5.0f;
+        uint8_t MaximumFlowTemperature = 50;
+        uint8_t MinimumFlowTemperature = 25;
+
+        float Zone1RoomTemperature = 20.1f;
+        bool Zone2Present = false;
+        float Zone2RoomTemperature = 18.4f;
+        float OutsideTemperature = 7.5f;
+
+        float DhwFeedTemperature = 38.25f;
+        float DhwReturnTemperature = 33.5f;
+        float DhwTemperature = 47.0f;
+        float BoilerFlowTemperature = 0.0f;
+        float BoilerReturnTemperature = 0.0f;
+
+        uint8_t Power = 1;
+        uint8_t Operation = 2;
+        uint8_t HotWaterMode = 0;
+        uint8_t HeatingCoolingMode = 0;
+        float DhwFlowTemperatureSetPoint = 50.0f;
+        float RadiatorFlowTemperatureSetPoint = 35.0f;
+        bool HolidayMode = false;
+        bool DhwTimerMode = true;
+
+        float EnergyConsumedHeating = 4.21f;
+        float EnergyConsumedCooling = 0.0f;
+        float EnergyConsumedDhw = 1.37f;
+        float EnergyDeliveredHeating = 14.8f;
+        float EnergyDeliveredCooling = 0.0f;
+        float EnergyDeliveredDhw = 3.02f;
+
+        // Slowly wander the live values, so consumers have something to track.
+        void tick(std::mt19937& rng, double seconds)
+        {
+            std::normal_distribution<float> noise{0.0f, 0.05f};
+            OutsideTemperature += noise(rng) * seconds;
+            Zone1RoomTemperature += ((Zone1SetTemperature - Zone1RoomTemperature) * 0.001f + noise(rng) * 0.1f) * seconds;
+
+            std::uniform_int_distribution<int> freq{-2, 2};
+            int f = int(CompressorFrequency) + freq(rng);
+            CompressorFrequency = static_cast<uint8_t>(f < 0 ? 0 : (f > 120 ? 120 : f));
+
+            std::uniform_real_distribution<float> chance{0.0f, 1.0f};
+            if (chance(rng) < 0.002f * seconds)
+                DefrostActive = !DefrostActive;
+
+            if (Power == 1)
+            {
+                EnergyConsumedHeating += 0.0004f * seconds;
+                EnergyDeliveredHeating += 0.0014f * seconds;
+            }
+        }
+    };
+
+    struct Options
+    {
+        std::string link;
+        unsigned latencyMs = 40;
+        unsigned baud = 2400;
+        double dropRate = 0.0;
+        double corruptRate = 0.0;
+        unsigned seed = 1;
+        bool zone2 = false;
+        bool verbose = false;
+    };
+
+    class Emulator
+    {
+      public:
+        Emulator(const Options& options, int fd)
+            : options_(options), fd_(fd), rng_(options.seed)
+        {
+            state_.Zone2Present = options.zone2;
+        }
+
+        void run(volatile sig_atomic_t& running)
+        {
+            auto lastTick = std::chrono::steady_clock::now();
+
+            while (running)
+            {
+                pollfd pfd = {fd_, POLLIN, 0};
+                int ready = poll(&pfd, 1, 100);
+
+                auto now = std::chrono::steady_clock::now();
+                state_.tick(rng_, std::chrono::duration<double>(now - lastTick).count());
+                lastTick = now;
+
+                if (ready <= 0 || !(pfd.revents & POLLIN))
+                    continue;
+
+                uint8_t rx[64];
+                ssize_t n = read(fd_, rx, sizeof(rx));
+                if (n <= 0)
+                {
+                    // No reader attached to the slave side yet.
+                    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                    continue;
+                }
+
+                for (ssize_t i = 0; i < n; ++i)
+                {
+                    Frame req;
+                    if (parser_.consume(rx[i], req))
+                        handle(req);
+                }
+            }
+
+            fprintf(stderr, "rx: %llu frames, tx: %llu frames, dropped: %llu responses, corrupted: %llu responses, rx bytes discarded: %llu, rx checksum errors: %llu\n",
+                    (unsigned long long)rxFrames_, (unsigned long long)txFrames_, (unsigned long long)droppedResponses_,
+                    (unsigned long long)corruptedResponses_, (unsigned long long)parser_.droppedBytes, (unsigned long long)parser_.checksumErrors);
+        }
+
+      private:
+        void handle(const Frame& req)
+        {
+            ++rxFrames_;
+
+            if (options_.verbose)
+                fprintf(stderr, "<- type %#x payload[0] %#x\n", static_cast<uint8_t>(req.type), req.payload[0]);
+
+            Frame res;
+            switch (req.type)
+            {
+            case MsgType::CONNECT_CMD:
+                res.type = MsgType::CONNECT_RES;
+                res.length = 1;
+                break;
+            case MsgType::EXT_CONNECT_CMD:
+                res.type = MsgType::EXT_CONNECT_RES;
+                res.length = PAYLOAD_SIZE;
+                res.payload[0] = 0xC9;
+                break;
+            case MsgType::GET_CMD:
+                if (!get(static_cast<GetType>(req.payload[0]), res))
+                    return;
+                break;
+            case MsgType::SET_CMD:
+                set(req);
+                res.type = MsgType::SET_RES;
+                res.length = PAYLOAD_SIZE;
+                res.payload[0] = req.payload[0];
+                break;
+            default:
+                fprintf(stderr, "ignoring unexpected message type %#x\n", static_cast<uint8_t>(req.type));
+                return;
+            }
+
+            std::uniform_real_distribution<double> chance{0.0, 1.0};
+            if (chance(rng_) < options_.dropRate)
+            {
+                ++droppedResponses_;
+                return;
+            }
+
+            std::vector<uint8_t> bytes = res.encode();
+            if (chance(rng_) < options_.corruptRate)
+            {
+                std::uniform_int_distribution<size_t> index{0, bytes.size() - 1};
+                bytes[index(rng_)] ^= 0x5A;
+                ++corruptedResponses_;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(options_.latencyMs));
+            transmit(bytes);
+            ++txFrames_;
+        }
+
+        // Pace output at the serial line rate; 8E1 framing costs 11 bits per byte.
+        void transmit(const std::vector<uint8_t>& bytes)
+        {
+            const auto byteTime = std::chrono::microseconds(11 * 1000000 / options_.baud);
+            auto next = std::chrono::steady_clock::now();
+
+            for (uint8_t b : bytes)
+            {
+                next += byteTime;
+                std::this_thread::sleep_until(next);
+                if (write(fd_, &b, 1) != 1)
+                    return;
+            }
+        }
+
+        bool get(GetType type, Frame& res)
+        {
+            res.type = MsgType::GET_RES;
+            res.length = PAYLOAD_SIZE;
+            res.payload[0] = static_cast<uint8_t>(type);
+
+            State& s = state_;
+            switch (type)
+            {
+            case GetType::DEFROST_STATE:
+                res.payload[3] = s.DefrostActive ? 1 : 0;
+                break;
+            case GetType::COMPRESSOR_FREQUENCY:
+                res.payload[1] = s.CompressorFrequency;
+                break;
+            case GetType::FORCED_DHW_STATE:
+                res.payload[7] = s.DhwForcedActive ? 1 : 0;
+                break;
+            case GetType::HEATING_POWER:
+                res.payload[6] = s.OutputPower;
+                break;
+            case GetType::TEMPERATURE_CONFIG:
+                res.set_float16(1, s.Zone1SetTemperature);
+                res.set_float16(3, s.Zone2SetTemperature);
+                res.set_float16(5, s.Zone1FlowTemperatureSetPoint);
+                res.set_float16(7, s.Zone2FlowTemperatureSetPoint);
+                res.set_float16(9, s.LegionellaPreventionSetPoint);
+                res.payload[11] = static_cast<uint8_t>(s.DhwTemperatureDrop * 2 + 40);
+                res.payload[12] = s.MaximumFlowTemperature + 80;
+                res.payload[13] = s.MinimumFlowTemperature + 80;
+                break;
+            case GetType::SH_TEMPERATURE_STATE:
+                res.set_float16(1, s.Zone1RoomTemperature);
+                if (s.Zone2Present)
+                    res.set_float16(3, s.Zone2RoomTemperature);
+                else
+                    res.set_u16(3, ZONE_NOT_PRESENT);
+                res.payload[11] = static_cast<uint8_t>(std::lround((s.OutsideTemperature + 40.0f) * 2));
+                break;
+            case GetType::DHW_TEMPERATURE_STATE_A:
+                res.set_float16(1, s.DhwFeedTemperature);
+                res.set_float16(4, s.DhwReturnTemperature);
+                res.set_float16(7, s.DhwTemperature);
+                break;
+            case GetType::DHW_TEMPERATURE_STATE_B:
+                res.set_float16(1, s.BoilerFlowTemperature);
+                res.set_float16(4, s.BoilerReturnTemperature);
+                break;
+            case GetType::ACTIVE_TIME:
+                break;
+            case GetType::FLOW_RATE:
+                res.payload[12] = s.FlowRate;
+                break;
+            case GetType::MODE_FLAGS_A:
+                res.payload[3] = s.Power;
+                res.payload[4] = s.Operation;
+                res.payload[5] = s.HotWaterMode;
+                res.payload[6] = s.HeatingCoolingMode;
+                res.set_float16(8, s.DhwFlowTemperatureSetPoint);
+                res.set_float16(12, s.RadiatorFlowTemperatureSetPoint);
+                break;
+            case GetType::MODE_FLAGS_B:
+                res.payload[4] = s.HolidayMode ? 1 : 0;
+                res.payload[5] = s.DhwTimerMode ? 1 : 0;
+                break;
+            case GetType::ENERGY_USAGE:
+                res.set_float24(4, s.EnergyConsumedHeating);
+                res.set_float24(7, s.EnergyConsumedCooling);
+                res.set_float24(10, s.EnergyConsumedDhw);
+                break;
+            case GetType::ENERGY_DELIVERY:
+                res.set_float24(4, s.EnergyDeliveredHeating);
+                res.set_float24(7, s.EnergyDeliveredCooling);
+                res.set_float24(10, s.EnergyDeliveredDhw);
+                break;
+            default:
+                fprintf(stderr, "ignoring GET_CMD for unknown register %#x\n", static_cast<uint8_t>(type));
+                return false;
+            }
+
+            return true;
+        }
+
+        void set(const Frame& req)
+        {
+            State& s = state_;
+            uint8_t flags = req.payload[1];
+
+            switch (static_cast<SetType>(req.payload[0]))
+            {
+            case SetType::BASIC_SETTINGS:
+                if (flags & SET_SETTINGS_FLAG_MODE_TOGGLE)
+                    s.Power = req.payload[3];
+
+                if (flags & SET_SETTINGS_FLAG_DHW_MODE)
+                    s.HotWaterMode = req.payload[5];
+
+                if (flags & SET_SETTINGS_FLAG_HP_MODE)
+                    s.HeatingCoolingMode = req.payload[6];
+
+                if (flags & SET_SETTINGS_FLAG_DHW_TEMPERATURE)
+                    s.DhwFlowTemperatureSetPoint = req.get_float16(8);
+
+                if (flags & SET_SETTINGS_FLAG_ZONE_TEMPERATURE)
+                {
+                    // Flow temperature targets are sent as zone temperatures with the flow control mode selected.
+                    bool flow = !(flags & SET_SETTINGS_FLAG_HP_MODE) && req.payload[6] == SET_HP_MODE_FLOW_CONTROL;
+                    switch (req.payload[2])
+                    {
+                    case SET_ZONE_1:
+                        (flow ? s.Zone1FlowTemperatureSetPoint : s.Zone1SetTemperature) = req.get_float16(10);
+                        break;
+                    case SET_ZONE_2:
+                        (flow ? s.Zone2FlowTemperatureSetPoint : s.Zone2SetTemperature) = req.get_float16(10);
+                        break;
+                    case SET_ZONE_BOTH:
+                        s.Zone1SetTemperature = req.get_float16(10);
+                        s.Zone2SetTemperature = req.get_float16(12);
+                        break;
+                    }
+                }
+                break;
+            case SetType::DHW_SETTING:
+                if (flags & SET_SETTINGS_FLAG_MODE_TOGGLE)
+                    s.DhwForcedActive = req.payload[3] != 0;
+                break;
+            default:
+                fprintf(stderr, "ignoring SET_CMD for unknown setting %#x\n", req.payload[0]);
+                break;
+            }
+        }
+
+        Options options_;
+        int fd_;
+        std::mt19937 rng_;
+        Parser parser_;
+        State state_;
+
+        uint64_t rxFrames_ = 0;
+        uint64_t txFrames_ = 0;
+        uint64_t droppedResponses_ = 0;
+        uint64_t corruptedResponses_ = 0;
+    };
+} // namespace cn105
+
+namespace
+{
+    volatile sig_atomic_t running = 1;
+
+    void on_signal(int)
+    {
+        running = 0;
+    }
+
+    void usage(const char* argv0)
+    {
+        fprintf(stderr, "usage: %s [--link PATH] [--latency-ms N] [--baud N] [--drop-rate P] [--corrupt-rate P] [--seed N] [--zone2] [--verbose]\n", argv0);
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    cn105::Options options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--link" && hasValue)
+            options.link = argv[++i];
+        else if (arg == "--latency-ms" && hasValue)
+            options.latencyMs = std::stoul(argv[++i]);
+        else if (arg == "--baud" && hasValue)
+            options.baud = std::stoul(argv[++i]);
+        else if (arg == "--drop-rate" && hasValue)
+            options.dropRate = std::stod(argv[++i]);
+        else if (arg == "--corrupt-rate" && hasValue)
+            options.corruptRate = std::stod(argv[++i]);
+        else if (arg == "--seed" && hasValue)
+            options.seed = std::stoul(argv[++i]);
+        else if (arg == "--zone2")
+            options.zone2 = true;
+        else if (arg == "--verbose")
+            options.verbose = true;
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.baud == 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0)
+    {
+        perror("posix_openpt");
+        return 1;
+    }
+
+    // Raw 2400 8E1; a pty doesn't enforce the line settings, the emulator paces its own output instead.
+    termios tio = {};
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    tio.c_cflag |= PARENB | CS8;
+    tio.c_cflag &= ~(PARODD | CSTOPB);
+    cfsetispeed(&tio, B2400);
+    cfsetospeed(&tio, B2400);
+    tcsetattr(fd, TCSANOW, &tio);
+
+    const char* slave = ptsname(fd);
+    printf("%s\n", slave);
+    fflush(stdout);
+
+    if (!options.link.empty())
+    {
+        unlink(options.link.c_str());
+        if (symlink(slave, options.link.c_str()) != 0)
+        {
+            perror("symlink");
+            return 1;
+        }
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    cn105::Emulator emulator{options, fd};
+    emulator.run(running);
+
+    if (!options.link.empty())
+        unlink(options.link.c_str());
+
+    close(fd);
+    return 0;
+}